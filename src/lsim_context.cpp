@@ -19,10 +19,12 @@ void LSimContext::load_reference_library(const char *name, const char *filename)
     }
 
     m_reference_libraries[name] = std::move(lib);
+    model_changed();
 }
 
 void LSimContext::clear_reference_libraries() {
     m_reference_libraries.clear();
+    model_changed();
 }
 
 ModelCircuit *LSimContext::find_circuit(const char *name, ModelCircuitLibrary *fallback_lib) {
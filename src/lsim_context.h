@@ -25,6 +25,10 @@ public:
     }
     ModelCircuit *find_circuit(const char *name, ModelCircuitLibrary *fallback_lib = nullptr);
 
+    // incremented by every change to the structure of a circuit, used to invalidate the circuit templates
+    uint64_t model_revision() const {return m_model_revision;}
+    void model_changed() {m_model_revision += 1;}
+
     // reference libraries
     void load_reference_library(const char *name, const char *filename);
     void clear_reference_libraries();
@@ -49,6 +53,8 @@ private:
 
     std::vector<std::string> m_folders;
     folder_lut_t m_folder_lut;
+
+    uint64_t m_model_revision = 1;
 };
 
 } // namespace lsim
@@ -60,6 +60,7 @@ ModelComponent *ModelCircuit::create_component(ComponentType type, uint32_t inpu
     auto component = std::make_unique<ModelComponent>(this, m_component_id++, type, input_pins, output_pins, control_pins);
     auto result = component.get();
     m_components[result->id()] = std::move(component);
+    invalidate_template();
 
     if (type == COMPONENT_CONNECTOR_IN || type == COMPONENT_CONNECTOR_OUT) {
         result->add_property(make_property("name", (std::string("c#") + std::to_string(result->id())).c_str()));
@@ -91,6 +92,7 @@ ModelComponent *ModelCircuit::create_component(const char *circuit_name, uint32_
     auto component = std::make_unique<ModelComponent>(this, m_component_id++, circuit_name, input_pins, output_pins);
     auto result = component.get();
     m_components[result->id()] = std::move(component);
+    invalidate_template();
     result->add_property(make_property("flip", false));
     result->add_property(make_property("caption", unique_subcircuit_name(circuit_name, result->id()).c_str()));
     return result;
@@ -146,6 +148,7 @@ void ModelCircuit::remove_component(uint32_t id) {
 
     disconnect_component(id);
     m_components.erase(found);
+    invalidate_template();
 
     if (was_connector) {
         rebuild_port_list();
@@ -170,7 +173,7 @@ ModelComponent *ModelCircuit::paste_component(ModelComponent *comp) {
 }
 
 ModelWire *ModelCircuit::create_wire() {
-    auto wire = std::make_unique<ModelWire>(m_wire_id++);
+    auto wire = std::make_unique<ModelWire>(m_wire_id++, this);
     auto result = wire.get();
     m_wires[result->id()] = std::move(wire);
     return result;
@@ -220,9 +223,13 @@ ModelWire *ModelCircuit::wire_by_id(uint32_t id) const {
 
 void ModelCircuit::remove_wire(uint32_t id) {
 	m_wires.erase(id);
+    invalidate_template();
 }
 
 void ModelCircuit::rebuild_port_list() {
+    // the names of the vias are only checked here, connect the vias again
+    invalidate_template();
+
     // clear current port list
     m_ports_lut.clear();
     m_input_ports.clear();
@@ -398,41 +405,105 @@ ModelComponent *ModelCircuit::add_text(const char *text) {
 }
 
 std::unique_ptr<SimCircuit> ModelCircuit::instantiate(Simulator *sim, bool top_level) {
-    auto instance = std::make_unique<SimCircuit>(sim, this);
-    std::unordered_map<std::string, ModelComponent *> via_lut;
-
-    // helper function to connect all pins of two vias
-    auto connect_vias = [&instance](ModelComponent *via_a, ModelComponent *via_b) {
-        assert(via_a->num_inputs() == via_b->num_inputs());
-        for (uint32_t i = 0u; i < via_a->num_inputs(); ++i) {
-            instance->connect_pins(via_a->input_pin_id(i), via_b->input_pin_id(i));
+    const auto &flat = flattened((sim->netlist_optimizations() & OPTIMIZE_LOOKUP_TABLES) != 0);
+
+    // stamp the components and their connections, the pins of the new components start at the first free pin
+    auto first_pin = static_cast<pin_t>(sim->num_pins());
+    std::vector<SimComponent *> components;
+    components.reserve(flat.num_components());
+
+    for (uint32_t idx = 0; idx < flat.num_components(); ++idx) {
+        components.push_back(sim->create_component(flat.component(idx)));
+    }
+    assert(sim->num_pins() == first_pin + flat.num_pins());
+
+    // the lookup table components share the truth tables of their circuits
+    std::vector<uint32_t> lookup_tables;
+    for (const auto &table : flat.lookup_tables()) {
+        lookup_tables.push_back(sim->add_lookup_table(std::shared_ptr<const LookupTable>(table, &table->table())));
+    }
+
+    for (const auto &lookup : flat.lookup_components()) {
+        auto comp = components[lookup.first];
+        comp->set_extra_data_size(sizeof(ExtraDataLookupTable));
+        reinterpret_cast<ExtraDataLookupTable *>(comp->extra_data())->m_table = lookup_tables[lookup.second];
+    }
+
+    for (const auto &conn : flat.connections()) {
+        sim->connect_pins(first_pin + conn.first, first_pin + conn.second);
+    }
+
+    // a SimCircuit for every circuit in the hierarchy, owned by the sub-circuit component that nests it
+    std::vector<std::unique_ptr<SimCircuit>> instances;
+    instances.reserve(flat.instances().size());
+
+    for (const auto &inst : flat.instances()) {
+        auto instance = std::make_unique<SimCircuit>(sim, inst.m_circuit);
+        for (auto entry = flat.entries_begin(inst); entry != flat.entries_end(inst); ++entry) {
+            instance->add_component(entry->first, components[entry->second]);
         }
-    };
+        if (inst.m_parent != TEMPLATE_NONE) {
+            instance->build_name(flat.component(inst.m_parent)->id());
+        }
+        instances.push_back(std::move(instance));
+    }
+
+    for (auto idx = instances.size() - 1; idx > 0; --idx) {
+        components[flat.instances()[idx].m_parent]->set_nested_instance(std::move(instances[idx]));
+    }
 
-    for (auto &comp_it : m_components) {
-        auto comp = comp_it.second.get();
-        auto sim_comp = instance->add_component(comp);
+    if (top_level) {
+        const auto &root = flat.instances().front();
+        for (auto entry = flat.entries_begin(root); entry != flat.entries_end(root); ++entry) {
+            auto type = flat.component(entry->second)->type();
+            auto comp = components[entry->second];
+            if (type == COMPONENT_CONNECTOR_IN) {
+                comp->enable_user_values();
+            }
 
-        if (comp->type() == COMPONENT_VIA) {
-            auto name = comp->property_value("name", "via");
-            auto found = via_lut.find(name);
-            if (found != via_lut.end()) {
-                connect_vias(comp, found->second);
-            } else {
-                via_lut[name] = comp;
+            // the ports of the top level circuit stay observable when the netlist is optimized
+            if (type == COMPONENT_CONNECTOR_IN || type == COMPONENT_CONNECTOR_OUT) {
+                for (auto idx = 0u; idx < comp->num_pins(); ++idx) {
+                    sim->pin_set_observed(comp->pin_by_index(idx));
+                }
             }
         }
 
-        if (top_level && comp->type() == COMPONENT_CONNECTOR_IN) {
-            sim_comp->enable_user_values();
-        }
+        // the complete netlist is known once the top level circuit is instantiated
+        sim->finalize();
+    }
+
+    return std::move(instances.front());
+}
+
+const CircuitTemplate &ModelCircuit::flattened(bool lookup_tables) {
+    assert(m_context);
+
+    auto &templ = m_templates[lookup_tables];
+    if (templ == nullptr || m_template_revision[lookup_tables] != m_context->model_revision()) {
+        templ = std::make_unique<CircuitTemplate>(this, lookup_tables);
+        m_template_revision[lookup_tables] = m_context->model_revision();
     }
 
-    for (auto &wire : m_wires) {
-        instance->add_wire(wire.second.get());
+    return *templ;
+}
+
+CircuitLookupTable::sptr_t ModelCircuit::lookup_table() {
+    assert(m_context);
+
+    // the simulators that use the previous table keep it alive
+    if (m_lookup_table_revision != m_context->model_revision()) {
+        m_lookup_table = CircuitLookupTable::qualifies(this) ? std::make_shared<CircuitLookupTable>(this) : nullptr;
+        m_lookup_table_revision = m_context->model_revision();
     }
 
-    return std::move(instance);
+    return m_lookup_table;
+}
+
+void ModelCircuit::invalidate_template() {
+    if (m_context != nullptr) {
+        m_context->model_changed();
+    }
 }
 
 } // namespace lsim
\ No newline at end of file
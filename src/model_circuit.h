@@ -12,6 +12,7 @@
 
 #include "model_component.h"
 #include "model_wire.h"
+#include "model_circuit_template.h"
 
 namespace lsim {
 
@@ -86,6 +87,14 @@ public:
     // instantiate into a simulator
     std::unique_ptr<class SimCircuit> instantiate(class Simulator *sim, bool top_level = true);
 
+    // the circuit flattened into a template, it's only rebuilt after the structure of a circuit of the context
+    //  changed (the templates include the nested circuits so a change invalidates all of them)
+    const CircuitTemplate &flattened(bool lookup_tables = false);
+    void invalidate_template();
+
+    // truth table of the circuit (nullptr when the circuit doesn't qualify), cached like the templates
+    CircuitLookupTable::sptr_t lookup_table();
+
 private:
     using component_lut_t = std::unordered_map<uint32_t, ModelComponent::uptr_t>;
     using port_container_t = std::vector<std::string>;
@@ -106,6 +115,10 @@ private:
     port_container_t m_input_ports;
     port_container_t m_output_ports;
 
+    std::unique_ptr<CircuitTemplate> m_templates[2];   // without / with lookup tables
+    uint64_t         m_template_revision[2] = {0, 0};   // model revision of the context when the template was built
+    CircuitLookupTable::sptr_t m_lookup_table;
+    uint64_t         m_lookup_table_revision = 0;
 };
 
 } // namespace lsim
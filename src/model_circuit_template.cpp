@@ -0,0 +1,152 @@
+// model_circuit_template.cpp - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// a circuit description flattened into a relocatable netlist
+
+#include "model_circuit_template.h"
+#include "model_circuit.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <unordered_map>
+
+namespace lsim {
+
+CircuitTemplate::CircuitTemplate(ModelCircuit *circuit, bool lookup_tables) {
+    assert(circuit);
+
+    // the entries of the root circuit come first, in order of model id
+    auto comp_ids = circuit->component_ids();
+    m_instances.push_back({circuit, TEMPLATE_NONE, 0, static_cast<uint32_t>(comp_ids.size())});
+    m_entries.resize(comp_ids.size());
+
+    std::unordered_map<std::string, ModelComponent *> via_lut;
+    std::vector<std::pair<ModelComponent *, ModelComponent *>> via_pairs;
+
+    for (size_t idx = 0; idx < comp_ids.size(); ++idx) {
+        auto comp = circuit->component_by_id(comp_ids[idx]);
+        auto nested_circuit = (comp->type() == COMPONENT_SUB_CIRCUIT) ? comp->nested_circuit() : nullptr;
+
+        // the lookup table has the same pins as the sub-circuit component (unless the component is out of sync)
+        CircuitLookupTable::sptr_t table = nullptr;
+        if (lookup_tables && nested_circuit != nullptr) {
+            table = nested_circuit->lookup_table();
+            if (table != nullptr && (table->table().m_num_inputs != comp->num_inputs() ||
+                                     table->table().m_num_outputs != comp->num_outputs())) {
+                table = nullptr;
+            }
+        }
+
+        auto templ_comp = add_component((table != nullptr) ? table->component() : comp);
+        m_entries[idx] = {comp->id(), templ_comp};
+
+        if (table != nullptr) {
+            m_lookup_components.push_back({templ_comp, lookup_table_index(table)});
+        } else if (nested_circuit != nullptr) {
+            const auto &nested = nested_circuit->flattened(lookup_tables);
+            auto nested_pin = m_num_pins;
+            append_nested(nested, templ_comp);
+
+            for (auto port = 0u; port < comp->num_inputs(); ++port) {
+                auto pin = nested.root_pin(nested_circuit->port_by_index(true, port));
+                connect(nested_pin + pin, m_first_pin[templ_comp] + port);
+            }
+            for (auto port = 0u; port < comp->num_outputs(); ++port) {
+                auto pin = nested.root_pin(nested_circuit->port_by_index(false, port));
+                connect(nested_pin + pin, m_first_pin[templ_comp] + comp->num_inputs() + port);
+            }
+        }
+
+        if (comp->type() == COMPONENT_VIA) {
+            auto name = comp->property_value("name", "via");
+            auto found = via_lut.find(name);
+            if (found != via_lut.end()) {
+                via_pairs.push_back({comp, found->second});
+            } else {
+                via_lut[name] = comp;
+            }
+        }
+    }
+
+    // vias with the same name are connected to each other
+    for (const auto &vias : via_pairs) {
+        assert(vias.first->num_inputs() == vias.second->num_inputs());
+        for (uint32_t i = 0u; i < vias.first->num_inputs(); ++i) {
+            connect(root_pin(vias.first->input_pin_id(i)), root_pin(vias.second->input_pin_id(i)));
+        }
+    }
+
+    for (const auto &wire_it : circuit->wires()) {
+        auto wire = wire_it.second.get();
+        for (auto index = 1u; index < wire->num_pins(); ++index) {
+            connect(root_pin(wire->pin(0)), root_pin(wire->pin(index)));
+        }
+    }
+}
+
+pin_t CircuitTemplate::root_pin(pin_id_t pin_id) const {
+    const auto &root = m_instances.front();
+    auto entry = std::lower_bound(entries_begin(root), entries_end(root),
+                                  entry_t(component_id_from_pin_id(pin_id), 0));
+    if (entry == entries_end(root) || entry->first != component_id_from_pin_id(pin_id)) {
+        return PIN_UNDEFINED;
+    }
+
+    return m_first_pin[entry->second] + pin_index_from_pin_id(pin_id);
+}
+
+uint32_t CircuitTemplate::add_component(ModelComponent *desc) {
+    auto result = static_cast<uint32_t>(m_components.size());
+    m_components.push_back(desc);
+    m_first_pin.push_back(m_num_pins);
+    m_num_pins += desc->num_inputs() + desc->num_outputs() + desc->num_controls();
+    return result;
+}
+
+uint32_t CircuitTemplate::lookup_table_index(const CircuitLookupTable::sptr_t &table) {
+    auto found = std::find(m_lookup_tables.begin(), m_lookup_tables.end(), table);
+    if (found != m_lookup_tables.end()) {
+        return static_cast<uint32_t>(found - m_lookup_tables.begin());
+    }
+
+    m_lookup_tables.push_back(table);
+    return static_cast<uint32_t>(m_lookup_tables.size() - 1);
+}
+
+void CircuitTemplate::append_nested(const CircuitTemplate &nested, uint32_t parent) {
+    auto first_comp = static_cast<uint32_t>(m_components.size());
+    auto first_pin = m_num_pins;
+    auto first_entry = static_cast<uint32_t>(m_entries.size());
+
+    m_components.insert(m_components.end(), nested.m_components.begin(), nested.m_components.end());
+    for (auto pin : nested.m_first_pin) {
+        m_first_pin.push_back(first_pin + pin);
+    }
+    m_num_pins += nested.m_num_pins;
+
+    for (const auto &conn : nested.m_connections) {
+        m_connections.push_back({first_pin + conn.first, first_pin + conn.second});
+    }
+
+    for (const auto &entry : nested.m_entries) {
+        m_entries.push_back({entry.first, first_comp + entry.second});
+    }
+
+    for (const auto &inst : nested.m_instances) {
+        auto inst_parent = (inst.m_parent == TEMPLATE_NONE) ? parent : first_comp + inst.m_parent;
+        m_instances.push_back({inst.m_circuit, inst_parent, first_entry + inst.m_first_entry, inst.m_num_entries});
+    }
+
+    for (const auto &lookup : nested.m_lookup_components) {
+        auto table = lookup_table_index(nested.m_lookup_tables[lookup.second]);
+        m_lookup_components.push_back({first_comp + lookup.first, table});
+    }
+}
+
+void CircuitTemplate::connect(pin_t pin_a, pin_t pin_b) {
+    assert(pin_a < m_num_pins);
+    assert(pin_b < m_num_pins);
+    m_connections.push_back({pin_a, pin_b});
+}
+
+} // namespace lsim
@@ -0,0 +1,79 @@
+// model_circuit_template.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// a circuit description flattened into a relocatable netlist
+
+#ifndef LSIM_MODEL_CIRCUIT_TEMPLATE_H
+#define LSIM_MODEL_CIRCUIT_TEMPLATE_H
+
+#include "sim_types.h"
+#include "model_lookup_table.h"
+
+#include <utility>
+#include <vector>
+
+namespace lsim {
+
+class ModelCircuit;
+class ModelComponent;
+
+// index of a template component that doesn't exist
+const uint32_t TEMPLATE_NONE = static_cast<uint32_t>(-1);
+
+// the components of a circuit and of all its nested circuits, in instantiation order, with the connections between
+//  their pins. Components and pins are numbered from zero: instantiating the template only adds the index of the first
+//  component/pin in the simulator, the model isn't walked again. A nested circuit is copied from its own template.
+//  With 'lookup_tables' set a sub-circuit whose circuit qualifies is replaced by a lookup table component.
+class CircuitTemplate {
+public:
+    using entry_t = std::pair<uint32_t, uint32_t>;          // (model component id, template component)
+    using connection_t = std::pair<pin_t, pin_t>;
+    using lookup_entry_t = std::pair<uint32_t, uint32_t>;   // (template component, index in lookup_tables())
+
+    // a circuit in the hierarchy, the root circuit is the first instance
+    struct Instance {
+        ModelCircuit *  m_circuit;
+        uint32_t        m_parent;           // sub-circuit component that nests the circuit (or TEMPLATE_NONE)
+        uint32_t        m_first_entry;      // index in m_entries, the entries of an instance are sorted by model id
+        uint32_t        m_num_entries;
+    };
+
+public:
+    explicit CircuitTemplate(ModelCircuit *circuit, bool lookup_tables = false);
+    CircuitTemplate(const CircuitTemplate &) = delete;
+
+    size_t num_components() const {return m_components.size();}
+    ModelComponent *component(uint32_t idx) const {return m_components[idx];}
+    size_t num_pins() const {return m_num_pins;}
+    pin_t first_pin(uint32_t idx) const {return m_first_pin[idx];}
+    const std::vector<connection_t> &connections() const {return m_connections;}
+
+    const std::vector<Instance> &instances() const {return m_instances;}
+    const entry_t *entries_begin(const Instance &inst) const {return m_entries.data() + inst.m_first_entry;}
+    const entry_t *entries_end(const Instance &inst) const {return entries_begin(inst) + inst.m_num_entries;}
+
+    const std::vector<CircuitLookupTable::sptr_t> &lookup_tables() const {return m_lookup_tables;}
+    const std::vector<lookup_entry_t> &lookup_components() const {return m_lookup_components;}
+
+    // template pin of a pin of a component of the root circuit (or PIN_UNDEFINED)
+    pin_t root_pin(pin_id_t pin_id) const;
+
+private:
+    uint32_t add_component(ModelComponent *desc);
+    uint32_t lookup_table_index(const CircuitLookupTable::sptr_t &table);
+    void append_nested(const CircuitTemplate &nested, uint32_t parent);
+    void connect(pin_t pin_a, pin_t pin_b);
+
+private:
+    std::vector<ModelComponent *>   m_components;
+    std::vector<pin_t>              m_first_pin;        // template component => first pin of the component
+    pin_t                           m_num_pins = 0;
+    std::vector<connection_t>       m_connections;
+    std::vector<Instance>           m_instances;
+    std::vector<entry_t>            m_entries;
+    std::vector<CircuitLookupTable::sptr_t> m_lookup_tables;
+    std::vector<lookup_entry_t>     m_lookup_components;
+};
+
+} // namespace lsim
+
+#endif // LSIM_MODEL_CIRCUIT_TEMPLATE_H
@@ -58,10 +58,16 @@ pin_id_t ModelComponent::control_pin_id(uint32_t index) const {
 
 void ModelComponent::change_input_pins(uint32_t new_count) {
     m_inputs = new_count;
+    if (m_circuit != nullptr) {
+        m_circuit->invalidate_template();
+    }
 }
 
 void ModelComponent::change_output_pins(uint32_t new_count) {
     m_outputs = new_count;
+    if (m_circuit != nullptr) {
+        m_circuit->invalidate_template();
+    }
 }
 
 pin_id_t ModelComponent::port_by_name(const char *name) const {
@@ -74,9 +80,17 @@ pin_id_t ModelComponent::port_by_name(const char *name) const {
 }
 
 void ModelComponent::add_property(Property::uptr_t &&prop) {
+    prop->set_owner(this);
     m_properties[prop->key()] = std::move(prop);
 }
 
+void ModelComponent::property_changed() {
+    // the flattened templates and lookup tables are built from the property values (constants, via names, ...)
+    if (m_circuit != nullptr) {
+        m_circuit->invalidate_template();
+    }
+}
+
 Property *ModelComponent::property(const char *key) {
     auto result = m_properties.find(key);
     if (result != m_properties.end()) {
@@ -105,6 +119,23 @@ Value ModelComponent::property_value(const char *key, Value def_value) {
     return (result != nullptr) ? result->value_as_lsim_value() : def_value;
 }
 
+void ModelComponent::set_propagation_delay(int64_t rise, int64_t fall) {
+    set_propagation_delay(rise, rise, rise, fall, fall, fall);
+}
+
+void ModelComponent::set_propagation_delay(int64_t rise_min, int64_t rise_typ, int64_t rise_max,
+                                           int64_t fall_min, int64_t fall_typ, int64_t fall_max) {
+    assert(rise_min <= rise_typ && rise_typ <= rise_max);
+    assert(fall_min <= fall_typ && fall_typ <= fall_max);
+
+    add_property(make_property("delay_rise", rise_typ));
+    add_property(make_property("delay_rise_min", rise_min));
+    add_property(make_property("delay_rise_max", rise_max));
+    add_property(make_property("delay_fall", fall_typ));
+    add_property(make_property("delay_fall_min", fall_min));
+    add_property(make_property("delay_fall_max", fall_max));
+}
+
 void ModelComponent::set_position(const Point &pos) {
     m_position = pos;
 }
@@ -114,6 +145,7 @@ void ModelComponent::set_angle(int angle) {
 }
 
 bool ModelComponent::sync_nested_circuit(LSimContext *lsim_context) {
+    m_circuit->invalidate_template();
 
     m_nested_circuit = lsim_context->find_circuit(m_nested_name.c_str(), m_circuit->lib());
     if (m_nested_circuit == nullptr) {
@@ -153,6 +185,7 @@ ModelComponent::uptr_t ModelComponent::copy() const {
 void ModelComponent::integrate_into_circuit(ModelCircuit *circuit, uint32_t id) {
     m_circuit = circuit;
     m_id = id;
+    m_circuit->invalidate_template();
 }
 
 } // namespace lsim
\ No newline at end of file
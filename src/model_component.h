@@ -63,6 +63,12 @@ public:
     bool property_value(const char *key, bool def_value);
     Value property_value(const char *key, Value def_value);
     const property_lut_t &properties() const {return m_properties;}
+    void property_changed();
+
+    // propagation delay (in simulation steps): optional, components without a delay respond in one step
+    void set_propagation_delay(int64_t rise, int64_t fall);
+    void set_propagation_delay(int64_t rise_min, int64_t rise_typ, int64_t rise_max,
+                               int64_t fall_min, int64_t fall_typ, int64_t fall_max);
 
     // position / orientation
     const Point &position() const {return m_position;}
@@ -0,0 +1,167 @@
+// model_lookup_table.cpp - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// truth table of a small combinational circuit, to simulate each instance of the circuit as one component
+
+#include "model_lookup_table.h"
+#include "model_circuit.h"
+#include "sim_bit_parallel.h"
+#include "sim_circuit.h"
+#include "simulator.h"
+
+#include <cassert>
+
+namespace lsim {
+
+namespace {
+
+bool is_logic(ComponentType type) {
+    return type == COMPONENT_BUFFER || (type >= COMPONENT_AND_GATE && type <= COMPONENT_XNOR_GATE);
+}
+
+} // unnamed namespace
+
+CircuitLookupTable::CircuitLookupTable(ModelCircuit *circuit) :
+        m_component(circuit, 0, COMPONENT_LOOKUP_TABLE, circuit->num_input_ports(), circuit->num_output_ports(), 0) {
+    assert(qualifies(circuit));
+
+    m_table.m_num_inputs = circuit->num_input_ports();
+    m_table.m_num_outputs = circuit->num_output_ports();
+
+    auto num_entries = size_t(1) << m_table.m_num_inputs;
+    m_table.m_values.assign(num_entries * m_table.m_num_outputs, VALUE_UNDEFINED);
+
+    // simulate the circuit on a private simulator, each lane of the bit-parallel simulator computes one entry
+    Simulator sim;
+    sim_register_component_functions(&sim);
+    auto instance = circuit->instantiate(&sim);
+
+    BitParallelSimulator psim(&sim);
+    psim.init();
+
+    for (size_t first = 0; first < num_entries; first += BIT_PARALLEL_LANES) {
+        for (auto input = 0u; input < m_table.m_num_inputs; ++input) {
+            uint64_t data = 0;
+            for (size_t lane = 0; lane < BIT_PARALLEL_LANES; ++lane) {
+                data |= static_cast<uint64_t>(((first + lane) >> input) & 1) << lane;
+            }
+            psim.write_pin(instance->pin_from_pin_id(circuit->port_by_index(true, input)), data);
+        }
+
+        psim.run_until_stable(2);
+
+        for (auto output = 0u; output < m_table.m_num_outputs; ++output) {
+            auto lanes = psim.read_pin(instance->pin_from_pin_id(circuit->port_by_index(false, output)));
+            for (size_t lane = 0; lane < BIT_PARALLEL_LANES && first + lane < num_entries; ++lane) {
+                m_table.m_values[(first + lane) * m_table.m_num_outputs + output] = lanes_value(lanes, lane);
+            }
+        }
+    }
+
+    // an output depends on an input when flipping only that input changes the output for any entry
+    m_table.m_dependencies.assign(m_table.m_num_outputs, 0);
+
+    for (size_t entry = 0; entry < num_entries; ++entry) {
+        for (auto input = 0u; input < m_table.m_num_inputs; ++input) {
+            auto other = entry | (size_t(1) << input);
+            if (other == entry) {
+                continue;
+            }
+            for (auto output = 0u; output < m_table.m_num_outputs; ++output) {
+                if (m_table.m_values[entry * m_table.m_num_outputs + output] !=
+                    m_table.m_values[other * m_table.m_num_outputs + output]) {
+                    m_table.m_dependencies[output] |= 1u << input;
+                }
+            }
+        }
+    }
+}
+
+bool CircuitLookupTable::qualifies(ModelCircuit *circuit) {
+    assert(circuit);
+
+    if (circuit->num_input_ports() > LOOKUP_TABLE_MAX_INPUTS || circuit->num_output_ports() == 0) {
+        return false;
+    }
+
+    const auto &flat = circuit->flattened();
+
+    for (uint32_t idx = 0; idx < flat.num_components(); ++idx) {
+        auto type = flat.component(idx)->type();
+        if (!is_logic(type) && type != COMPONENT_CONNECTOR_IN && type != COMPONENT_CONNECTOR_OUT &&
+            type != COMPONENT_CONSTANT && type != COMPONENT_VIA && type != COMPONENT_SUB_CIRCUIT &&
+            type != COMPONENT_TEXT) {
+            return false;
+        }
+    }
+
+    // the nodes of the pins
+    std::vector<pin_t> pin_parent(flat.num_pins());
+    for (pin_t pin = 0; pin < pin_parent.size(); ++pin) {
+        pin_parent[pin] = pin;
+    }
+
+    auto pin_root = [&pin_parent](pin_t pin) {
+        while (pin_parent[pin] != pin) {
+            pin_parent[pin] = pin_parent[pin_parent[pin]];
+            pin = pin_parent[pin];
+        }
+        return pin;
+    };
+
+    for (const auto &conn : flat.connections()) {
+        pin_parent[pin_root(conn.first)] = pin_root(conn.second);
+    }
+
+    // no feedback loops: all the gates can be sorted topologically (Kahn's algorithm)
+    std::vector<uint32_t> node_drivers(flat.num_pins(), 0);
+    std::vector<std::vector<uint32_t>> node_readers(flat.num_pins());
+    std::vector<uint32_t> num_pending(flat.num_components(), 0);
+    std::vector<uint32_t> ready;
+    size_t num_gates = 0;
+
+    for (uint32_t idx = 0; idx < flat.num_components(); ++idx) {
+        auto comp = flat.component(idx);
+        if (!is_logic(comp->type())) {
+            continue;
+        }
+        for (auto output = 0u; output < comp->num_outputs(); ++output) {
+            node_drivers[pin_root(flat.first_pin(idx) + comp->num_inputs() + output)] += 1;
+        }
+    }
+
+    for (uint32_t idx = 0; idx < flat.num_components(); ++idx) {
+        auto comp = flat.component(idx);
+        if (!is_logic(comp->type())) {
+            continue;
+        }
+        num_gates += 1;
+        for (auto input = 0u; input < comp->num_inputs(); ++input) {
+            auto node = pin_root(flat.first_pin(idx) + input);
+            num_pending[idx] += node_drivers[node];
+            node_readers[node].push_back(idx);
+        }
+        if (num_pending[idx] == 0) {
+            ready.push_back(idx);
+        }
+    }
+
+    size_t num_sorted = 0;
+    while (!ready.empty()) {
+        auto idx = ready.back();
+        ready.pop_back();
+        num_sorted += 1;
+
+        auto comp = flat.component(idx);
+        for (auto output = 0u; output < comp->num_outputs(); ++output) {
+            for (auto reader : node_readers[pin_root(flat.first_pin(idx) + comp->num_inputs() + output)]) {
+                if (--num_pending[reader] == 0) {
+                    ready.push_back(reader);
+                }
+            }
+        }
+    }
+
+    return num_sorted == num_gates;
+}
+
+} // namespace lsim
@@ -0,0 +1,41 @@
+// model_lookup_table.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// truth table of a small combinational circuit, to simulate each instance of the circuit as one component
+
+#ifndef LSIM_MODEL_LOOKUP_TABLE_H
+#define LSIM_MODEL_LOOKUP_TABLE_H
+
+#include "model_component.h"
+
+#include <memory>
+
+namespace lsim {
+
+// circuits with more input ports aren't turned into a lookup table
+const uint32_t LOOKUP_TABLE_MAX_INPUTS = 12;
+
+// the truth table of a circuit and the description of the component that replaces an instance of the circuit.
+//  Only circuits with at most LOOKUP_TABLE_MAX_INPUTS input ports that consist of logic gates and buffers
+//  (nested circuits included) without feedback loops qualify: their outputs only depend on the current inputs.
+class CircuitLookupTable {
+public:
+    using sptr_t = std::shared_ptr<CircuitLookupTable>;
+
+public:
+    // enumerates all the input combinations with the bit-parallel simulator
+    explicit CircuitLookupTable(ModelCircuit *circuit);
+    CircuitLookupTable(const CircuitLookupTable &) = delete;
+
+    static bool qualifies(ModelCircuit *circuit);
+
+    ModelComponent *component() {return &m_component;}
+    const LookupTable &table() const {return m_table;}
+
+private:
+    ModelComponent  m_component;
+    LookupTable     m_table;
+};
+
+} // namespace lsim
+
+#endif // LSIM_MODEL_LOOKUP_TABLE_H
@@ -3,6 +3,7 @@
 // Key/value pair to store extra information about specific components
 
 #include "model_property.h"
+#include "model_component.h"
 
 #include <algorithm>
 
@@ -48,6 +49,17 @@ inline lsim::Value int_to_value(int64_t val) {
 
 namespace lsim {
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// Property
+//
+
+void Property::value_changed() {
+    if (m_owner != nullptr) {
+        m_owner->property_changed();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // StringProperty
@@ -80,18 +92,22 @@ Value StringProperty::value_as_lsim_value() const {
 
 void StringProperty::value(const char *val) {
     m_value = val;
+    value_changed();
 }
 
 void StringProperty::value(int64_t val) {
     m_value = std::to_string(val);   
+    value_changed();
 }
 
 void StringProperty::value(bool val) {
     m_value = (val) ? "true" : "false";
+    value_changed();
 }
 
 void StringProperty::value(Value val) {
     m_value = VALUE_STRINGS[val];
+    value_changed();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -126,18 +142,22 @@ Value IntegerProperty::value_as_lsim_value() const {
 
 void IntegerProperty::value(const char *val) {
     m_value = std::strtoll(val, nullptr, 0);
+    value_changed();
 }
 
 void IntegerProperty::value(int64_t val) {
     m_value = val;
+    value_changed();
 }
 
 void IntegerProperty::value(bool val) {
     m_value = (val) ? 1 : 0;
+    value_changed();
 }
 
 void IntegerProperty::value(Value val) {
     m_value = static_cast<int64_t> (val);
+    value_changed();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -172,18 +192,22 @@ Value BoolProperty::value_as_lsim_value() const {
 
 void BoolProperty::value(const char *val) {
     m_value = string_to_bool(val);
+    value_changed();
 }
 
 void BoolProperty::value(int64_t val) {
     m_value = val != 0;
+    value_changed();
 }
 
 void BoolProperty::value(bool val) {
     m_value = val;
+    value_changed();
 }
 
 void BoolProperty::value(Value val) {
     m_value = val == VALUE_TRUE;
+    value_changed();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -218,18 +242,22 @@ Value ValueProperty::value_as_lsim_value() const {
 
 void ValueProperty::value(const char *val) {
     m_value = string_to_value(val);
+    value_changed();
 }
 
 void ValueProperty::value(int64_t val) {
     m_value = int_to_value(val);
+    value_changed();
 }
 
 void ValueProperty::value(bool val) {
     m_value = (val) ? VALUE_TRUE : VALUE_FALSE;
+    value_changed();
 }
 
 void ValueProperty::value(Value val) {
     m_value = val;
+    value_changed();
 }
 
 } // namespace lsim
\ No newline at end of file
@@ -11,6 +11,8 @@
 
 namespace lsim {
 
+class ModelComponent;
+
 class Property {
 public:
     using uptr_t = std::unique_ptr<Property>;
@@ -32,8 +34,15 @@ public:
     virtual void value(bool val) = 0;
     virtual void value(Value val) = 0;
 
+    // the component is notified when the value changes (set by ModelComponent::add_property)
+    void set_owner(ModelComponent *owner) {m_owner = owner;}
+
+protected:
+    void value_changed();
+
 private:
     std::string m_key;
+    ModelComponent *m_owner = nullptr;
 };
 
 class StringProperty : public Property {
@@ -71,12 +71,15 @@ void ModelWireSegment::move(const Point& delta) {
 // ModelWire
 //
 
-ModelWire::ModelWire(uint32_t id) : m_id(id) {
-
+ModelWire::ModelWire(uint32_t id, ModelCircuit *circuit) :
+        m_circuit(circuit),
+        m_id(id) {
+    assert(circuit);
 }
 
 void ModelWire::add_pin(pin_id_t pin) {
     m_pins.push_back(pin);
+    m_circuit->invalidate_template();
 }
 
 pin_id_t ModelWire::pin(size_t index) const {
@@ -89,14 +92,17 @@ void ModelWire::remove_component_pins(uint32_t component_id) {
 							return component_id_from_pin_id(pin_id) == component_id;
 					  }
 			 );
+    m_circuit->invalidate_template();
 }
 
 void ModelWire::remove_pin(pin_id_t pin) {
 	remove(m_pins, pin);
+    m_circuit->invalidate_template();
 }
 
 void ModelWire::clear_pins() {
     m_pins.clear();
+    m_circuit->invalidate_template();
 }
 
 const Point &ModelWire::segment_point(size_t segment_idx, size_t point_idx) const {
@@ -158,6 +164,7 @@ void ModelWire::merge(ModelWire *other) {
     } 
 
 	std::copy(other->m_pins.begin(), other->m_pins.end(), std::back_inserter(m_pins));
+    m_circuit->invalidate_template();
 }
 
 void ModelWire::split_at_new_junction(const Point &p) {
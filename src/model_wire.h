@@ -60,7 +60,7 @@ public:
     using segment_set_t = std::set<ModelWireSegment *>;
 
 public:
-    ModelWire(uint32_t id);
+    ModelWire(uint32_t id, class ModelCircuit *circuit);
     ModelWire(const ModelWire &) = delete;
     uint32_t id() const {return m_id;}
 
@@ -105,6 +105,7 @@ private:
     void remove_redundant_segment(ModelWireSegment *segment);
 
 private:
+    class ModelCircuit *m_circuit;
     uint32_t m_id;
     pin_id_container_t    m_pins;
     junction_container_t  m_junctions;
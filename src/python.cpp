@@ -7,6 +7,8 @@
 #include "lsim_context.h"
 #include "model_circuit.h"
 #include "sim_circuit.h"
+#include "sim_bit_parallel.h"
+#include "sim_compiled.h"
 #include "serialize.h"
 
 namespace py = pybind11;
@@ -14,6 +16,9 @@ using namespace lsim;
 
 PYBIND11_MODULE(lsimpy, m) {
     m.def("pin_id_invalid", [](pin_id_t pin) -> bool {return pin == PIN_ID_INVALID;});
+    m.attr("STEPS_NOT_STABLE") = STEPS_NOT_STABLE;
+    m.attr("STEPS_WATCHPOINT") = STEPS_WATCHPOINT;
+    m.attr("STEPS_NOT_MET") = STEPS_NOT_MET;
 
     py::enum_<Value>(m, "Value", py::arithmetic())
         .value("ValueFalse", lsim::Value::VALUE_FALSE)
@@ -23,6 +28,32 @@ PYBIND11_MODULE(lsimpy, m) {
         .export_values()
     ;
 
+    py::enum_<TimingMode>(m, "TimingMode")
+        .value("TimingUnitDelay", TimingMode::TIMING_UNIT_DELAY)
+        .value("TimingMinimum", TimingMode::TIMING_MINIMUM)
+        .value("TimingTypical", TimingMode::TIMING_TYPICAL)
+        .value("TimingMaximum", TimingMode::TIMING_MAXIMUM)
+        .value("TimingRandom", TimingMode::TIMING_RANDOM)
+        .value("TimingLevelized", TimingMode::TIMING_LEVELIZED)
+        .export_values()
+    ;
+
+    py::enum_<WatchType>(m, "WatchType")
+        .value("WatchChange", WatchType::WATCH_CHANGE)
+        .value("WatchRisingEdge", WatchType::WATCH_RISING_EDGE)
+        .value("WatchFallingEdge", WatchType::WATCH_FALLING_EDGE)
+        .value("WatchValue", WatchType::WATCH_VALUE)
+        .export_values()
+    ;
+
+    py::enum_<NetlistOptimization>(m, "NetlistOptimization", py::arithmetic())
+        .value("OptimizeNone", NetlistOptimization::OPTIMIZE_NONE)
+        .value("OptimizeConstants", NetlistOptimization::OPTIMIZE_CONSTANTS)
+        .value("OptimizeMergeGates", NetlistOptimization::OPTIMIZE_MERGE_GATES)
+        .value("OptimizeLookupTables", NetlistOptimization::OPTIMIZE_LOOKUP_TABLES)
+        .export_values()
+    ;
+
     py::class_<Point>(m, "Point")
         .def(py::init<float, float>())
         .def("x", [](Point *point) -> float { return point->x; })
@@ -79,11 +110,134 @@ PYBIND11_MODULE(lsimpy, m) {
         .def("instantiate", &ModelCircuit::instantiate, py::arg("sim"), py::arg("top_level") = true)
     ;
 
+    py::class_<RunCondition>(m, "RunCondition")
+        .def(py::init<>())
+        .def("node_value", &RunCondition::node_value, py::return_value_policy::reference_internal)
+        .def("rising_edge", &RunCondition::rising_edge, py::return_value_policy::reference_internal)
+        .def("falling_edge", &RunCondition::falling_edge, py::return_value_policy::reference_internal)
+        .def("bus_value", &RunCondition::bus_value, py::return_value_policy::reference_internal,
+             py::arg("nodes"), py::arg("value"), py::arg("mask") = ~0ull)
+        .def("num_terms", &RunCondition::num_terms)
+    ;
+
     py::class_<Simulator>(m, "Simulator")
         .def(py::init<>())
         .def("init", &Simulator::init)
-        .def("step", &Simulator::step)
-        .def("run_until_stable", &Simulator::run_until_stable)
+        .def("step", &Simulator::step, py::call_guard<py::gil_scoped_release>())
+        .def("run_until", &Simulator::run_until, py::call_guard<py::gil_scoped_release>())
+        .def("current_time", &Simulator::current_time)
+        .def("run_until_stable", &Simulator::run_until_stable, py::arg("stable_ticks"), py::arg("max_steps") = STEPS_UNLIMITED,
+             py::call_guard<py::gil_scoped_release>())
+        .def("steps_until_stable", &Simulator::steps_until_stable, py::arg("stable_ticks"), py::arg("max_steps") = STEPS_UNLIMITED,
+             py::call_guard<py::gil_scoped_release>())
+        .def("nodes_changed_last_step", &Simulator::nodes_changed_last_step)
+        .def("run", &Simulator::run, py::call_guard<py::gil_scoped_release>())
+        .def("last_run_term", &Simulator::last_run_term)
+        .def("add_watchpoint", &Simulator::add_watchpoint, py::arg("node"), py::arg("type"), py::arg("value") = VALUE_TRUE)
+        .def("remove_watchpoint", &Simulator::remove_watchpoint)
+        .def("clear_watchpoints", &Simulator::clear_watchpoints)
+        .def("watchpoint_hit", &Simulator::watchpoint_hit)
+        .def("watchpoint_hits", &Simulator::watchpoint_hits, py::return_value_policy::copy)
+        .def("generation", &Simulator::generation)
+        .def("changed_nodes_since", [](Simulator *sim, uint64_t generation) {
+                    node_container_t changed;
+                    auto current = sim->changed_nodes_since(generation, changed);
+                    return std::make_pair(current, changed);
+                })
+        .def("set_timing_mode", &Simulator::set_timing_mode, py::arg("mode"), py::arg("seed") = 0)
+        .def("timing_mode", &Simulator::timing_mode)
+        .def("add_clock",
+                [](Simulator *sim, SimCircuit *circuit, uint32_t comp_id) {
+                    sim->add_clock(circuit->component_by_id(comp_id));
+                })
+        .def("clear_clocks", &Simulator::clear_clocks)
+        .def("run_cycles", &Simulator::run_cycles, py::arg("num_cycles"), py::arg("max_steps_per_edge") = 10000,
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_num_threads", &Simulator::set_num_threads)
+        .def("num_threads", &Simulator::num_threads)
+        .def("set_parallel_threshold", &Simulator::set_parallel_threshold)
+        .def("parallel_threshold", &Simulator::parallel_threshold)
+        .def("last_step_stats", &Simulator::last_step_stats, py::return_value_policy::copy)
+        .def("set_netlist_optimizations", &Simulator::set_netlist_optimizations)
+        .def("netlist_optimizations", &Simulator::netlist_optimizations)
+        .def("netlist_reduction", &Simulator::netlist_reduction)
+        .def("pin_set_observed",
+                [](Simulator *sim, SimCircuit *circuit, pin_id_t pin_id) {
+                    sim->pin_set_observed(circuit->pin_from_pin_id(pin_id));
+                })
+        .def("snapshot", &Simulator::snapshot)
+        .def("restore", &Simulator::restore)
+        .def("fork", &Simulator::fork)
+        ;
+
+    py::class_<Simulator::Snapshot>(m, "SimulatorSnapshot");
+
+    py::class_<WatchpointHit>(m, "WatchpointHit")
+        .def_readonly("watch", &WatchpointHit::m_watch)
+        .def_readonly("node", &WatchpointHit::m_node)
+        .def_readonly("value", &WatchpointHit::m_value)
+        .def_readonly("time", &WatchpointHit::m_time)
+        ;
+
+    py::class_<WorkerPoolStats>(m, "WorkerPoolStats")
+        .def_readonly("num_tasks", &WorkerPoolStats::m_num_tasks)
+        .def_readonly("num_stolen", &WorkerPoolStats::m_num_stolen)
+        .def_readonly("wall_time", &WorkerPoolStats::m_wall_time)
+        .def_readonly("busy_time", &WorkerPoolStats::m_busy_time)
+        .def_readonly("efficiency", &WorkerPoolStats::m_efficiency)
+        ;
+
+    py::class_<StepStats>(m, "StepStats")
+        .def_readonly("dirty_components", &StepStats::m_dirty_components)
+        .def_readonly("parallel", &StepStats::m_parallel)
+        .def_readonly("pool", &StepStats::m_pool)
+        ;
+
+    py::class_<NetlistReduction>(m, "NetlistReduction")
+        .def_readonly("folded_gates", &NetlistReduction::m_folded_gates)
+        .def_readonly("dead_gates", &NetlistReduction::m_dead_gates)
+        .def_readonly("merged_gates", &NetlistReduction::m_merged_gates)
+        ;
+
+    py::class_<BitParallelSimulator>(m, "BitParallelSimulator")
+        .def(py::init<Simulator *>(), py::keep_alive<1, 2>())
+        .def("init", &BitParallelSimulator::init)
+        .def("step", &BitParallelSimulator::step)
+        .def("current_time", &BitParallelSimulator::current_time)
+        .def("run_until_stable", &BitParallelSimulator::run_until_stable, py::arg("stable_ticks"), py::arg("max_steps") = STEPS_UNLIMITED)
+        .def("write_port",
+                [](BitParallelSimulator *sim, SimCircuit *circuit, const char *port, const value_container_t &lanes) {
+                    sim->write_pin(circuit->pin_from_pin_id(circuit->description()->port_by_name(port)), lanes);
+                })
+        .def("write_port",
+                [](BitParallelSimulator *sim, SimCircuit *circuit, const char *port, uint64_t data) {
+                    sim->write_pin(circuit->pin_from_pin_id(circuit->description()->port_by_name(port)), data);
+                })
+        .def("read_port",
+                [](BitParallelSimulator *sim, SimCircuit *circuit, const char *port) -> value_container_t {
+                    return sim->read_pin_values(circuit->pin_from_pin_id(circuit->description()->port_by_name(port)));
+                })
+        ;
+
+    py::class_<CompiledSimulator>(m, "CompiledSimulator")
+        .def(py::init<Simulator *>(), py::keep_alive<1, 2>())
+        .def("compile", [](CompiledSimulator *sim) {return sim->compile();})
+        .def("compile", [](CompiledSimulator *sim, const char *cache_dir) {return sim->compile(cache_dir);})
+        .def("is_compiled", &CompiledSimulator::is_compiled)
+        .def("library_path", &CompiledSimulator::library_path)
+        .def("loaded_from_cache", &CompiledSimulator::loaded_from_cache)
+        .def("init", &CompiledSimulator::init)
+        .def("step", &CompiledSimulator::step)
+        .def("current_time", &CompiledSimulator::current_time)
+        .def("run_until_stable", &CompiledSimulator::run_until_stable, py::arg("stable_ticks"), py::arg("max_steps") = STEPS_UNLIMITED)
+        .def("write_port",
+                [](CompiledSimulator *sim, SimCircuit *circuit, const char *port, Value value) {
+                    sim->write_pin(circuit->pin_from_pin_id(circuit->description()->port_by_name(port)), value);
+                })
+        .def("read_port",
+                [](CompiledSimulator *sim, SimCircuit *circuit, const char *port) {
+                    return sim->read_pin(circuit->pin_from_pin_id(circuit->description()->port_by_name(port)));
+                })
         ;
 
     py::class_<ModelCircuitLibrary>(m, "ModelCircuitLibrary")
@@ -114,6 +268,8 @@ PYBIND11_MODULE(lsimpy, m) {
         ;
 
     py::class_<SimCircuit>(m, "SimCircuit")
+        .def("clone", &SimCircuit::clone, py::keep_alive<0, 2>())
+        .def("pin_node", &SimCircuit::pin_node)
         .def("read_pin", &SimCircuit::read_pin)
         .def("read_nibble", (uint8_t (SimCircuit::*)(uint32_t)) &SimCircuit::read_nibble)
         .def("read_nibble", (uint8_t (SimCircuit::*)(const pin_id_container_t &)) &SimCircuit::read_nibble)
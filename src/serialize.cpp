@@ -430,6 +430,13 @@ public:
             component->property("initial_output")->value(initial_output_node.attribute(XML_ATTR_VALUE).value());
         }
 
+        for (auto key : {"delay_rise", "delay_rise_min", "delay_rise_max", "delay_fall", "delay_fall_min", "delay_fall_max"}) {
+            auto delay_node = comp_node.find_child_by_attribute(XML_EL_PROPERTY, XML_ATTR_KEY, key);
+            if (!!delay_node) {
+                component->add_property(make_property(key, delay_node.attribute(XML_ATTR_VALUE).as_llong()));
+            }
+        }
+
         // visual properties
         auto pos_node = comp_node.child(XML_EL_POSITION);
         if (!!pos_node) {
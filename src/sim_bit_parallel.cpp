@@ -0,0 +1,320 @@
+// sim_bit_parallel.cpp - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// simulates 64 independent copies (lanes) of the netlist at once, e.g. to run exhaustive test benches
+
+#include "sim_bit_parallel.h"
+#include "simulator.h"
+#include "sim_component.h"
+#include "model_component.h"
+#include "error.h"
+
+#include <cassert>
+
+namespace {
+
+using namespace lsim;
+
+// components that step() simulates or that don't write to their pins during the simulation
+bool is_supported(ComponentType type) {
+    return (type >= COMPONENT_CONNECTOR_IN && type <= COMPONENT_XNOR_GATE) || type == COMPONENT_VIA ||
+           type == COMPONENT_OSCILLATOR || type == COMPONENT_SUB_CIRCUIT || type == COMPONENT_TEXT;
+}
+
+} // unnamed namespace
+
+namespace lsim {
+
+LaneValues lanes_from_values(const value_container_t &values) {
+    assert(values.size() <= BIT_PARALLEL_LANES);
+
+    LaneValues result = {0, 0};
+    for (size_t lane = 0; lane < values.size(); ++lane) {
+        result.m_bit0 |= static_cast<uint64_t>(values[lane] & 1) << lane;
+        result.m_bit1 |= static_cast<uint64_t>((values[lane] >> 1) & 1) << lane;
+    }
+    return result;
+}
+
+value_container_t lanes_to_values(LaneValues lanes) {
+    value_container_t result(BIT_PARALLEL_LANES);
+    for (size_t lane = 0; lane < BIT_PARALLEL_LANES; ++lane) {
+        result[lane] = lanes_value(lanes, lane);
+    }
+    return result;
+}
+
+BitParallelSimulator::BitParallelSimulator(Simulator *sim) :
+        m_sim(sim) {
+    assert(sim);
+}
+
+bool BitParallelSimulator::init() {
+    for (const auto &comp : m_sim->m_components) {
+        auto type = comp.description()->type();
+        if (!is_supported(type)) {
+            ERROR_MSG("Component type 0x%04x can't be simulated bit-parallel", type);
+            return false;
+        }
+    }
+
+    m_sim->init();
+    build_topology();
+
+    m_time = m_sim->m_time;
+
+    // start all lanes from the initial state of the scalar simulator
+    for (size_t pin = 0; pin < m_pin_values.size(); ++pin) {
+        m_pin_values[pin] = lanes_broadcast(m_sim->m_pin_values[pin]);
+        m_pin_active[pin] = m_sim->m_pin_active[pin] ? ~0ull : 0ull;
+    }
+
+    for (size_t node = 0; node < m_node_values.size(); ++node) {
+        m_node_values[node] = lanes_broadcast(m_sim->m_node_values_read[node]);
+        m_node_defaults[node] = lanes_broadcast(m_sim->m_node_defaults[node]);
+    }
+
+    m_dirty_nodes_read = m_sim->m_dirty_nodes_read;
+    m_dirty_nodes_write.clear();
+    m_pending_writes.clear();
+
+    m_oscillators.clear();
+    for (auto &comp : m_sim->m_components) {
+        if (comp.description()->type() == COMPONENT_OSCILLATOR) {
+            auto *extra = reinterpret_cast<ExtraDataOscillator *>(comp.extra_data());
+            auto pin = comp.pin_by_index(comp.output_pin_index(0));
+            m_oscillators.push_back({pin, m_sim->pin_output_value(pin), extra->m_next_change,
+                                     {extra->m_duration[0], extra->m_duration[1]}});
+        }
+    }
+
+    return true;
+}
+
+void BitParallelSimulator::build_topology() {
+    auto num_pins = m_sim->m_pin_nodes.size();
+    auto num_nodes = m_sim->m_node_values_read.size();
+    auto num_components = m_sim->m_components.size();
+
+    m_component_types.resize(num_components);
+    m_input_changed.assign(num_components, 0);
+    m_dirty_components.clear();
+
+    m_pin_values.resize(num_pins);
+    m_pin_active.resize(num_pins);
+
+    m_node_defaults.resize(num_nodes);
+    m_node_values.resize(num_nodes);
+    m_node_time_dirty_write.assign(num_nodes, 0);
+
+    // only the output pins of the components ever drive a node
+    std::vector<pin_container_t> drivers(num_nodes);
+
+    for (auto &comp : m_sim->m_components) {
+        m_component_types[comp.id()] = comp.description()->type();
+
+        for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+            auto pin = comp.pin_by_index(comp.output_pin_index(idx));
+            drivers[m_sim->m_pin_nodes[pin]].push_back(pin);
+        }
+    }
+
+    m_node_drivers.clear();
+    for (const auto &pins : drivers) {
+        m_node_drivers.append_row(std::begin(pins), std::end(pins));
+    }
+}
+
+void BitParallelSimulator::step() {
+    m_time = m_time + 1;
+    m_dirty_components.clear();
+
+    // >> build a unique list of components with changed input values
+    for (auto node_id : m_dirty_nodes_read) {
+        auto &dependents = m_sim->m_topology->m_node_dependents;
+        for (auto dep = dependents.row_begin(node_id); dep != dependents.row_end(node_id); ++dep) {
+            if (m_input_changed[*dep] != m_time) {
+                m_input_changed[*dep] = m_time;
+                m_dirty_components.push_back(*dep);
+            }
+        }
+    }
+
+    // >> run simulation: changed inputs
+    for (auto comp_id : m_dirty_components) {
+        switch (m_component_types[comp_id]) {
+            case COMPONENT_BUFFER : {
+                auto pins = m_sim->component_pins(comp_id);
+                auto num_inputs = m_sim->component_num_pins(comp_id) / 2;
+                for (auto pin = 0u; pin < num_inputs; ++pin) {
+                    drive_pin(pins[num_inputs + pin], read_pin(pins[pin]));
+                }
+                break;
+            }
+            case COMPONENT_TRISTATE_BUFFER : {
+                auto pins = m_sim->component_pins(comp_id);
+                auto num_inputs = (m_sim->component_num_pins(comp_id) - 1) / 2;
+                auto control = read_pin(pins[2 * num_inputs]);
+                auto enabled = control.m_bit0 & ~control.m_bit1;
+
+                for (auto pin = 0u; pin < num_inputs; ++pin) {
+                    auto input = read_pin(pins[pin]);
+                    drive_pin(pins[num_inputs + pin], {input.m_bit0 & enabled, input.m_bit1 | ~enabled});
+                }
+                break;
+            }
+            case COMPONENT_AND_GATE :
+                gate_kernel(comp_id, 0, [](uint64_t a, uint64_t b) {return a & b;});
+                break;
+            case COMPONENT_OR_GATE :
+                gate_kernel(comp_id, 0, [](uint64_t a, uint64_t b) {return a | b;});
+                break;
+            case COMPONENT_NOT_GATE :
+                gate_kernel(comp_id, ~0ull, [](uint64_t a, uint64_t) {return a;});
+                break;
+            case COMPONENT_NAND_GATE :
+                gate_kernel(comp_id, ~0ull, [](uint64_t a, uint64_t b) {return a & b;});
+                break;
+            case COMPONENT_NOR_GATE :
+                gate_kernel(comp_id, ~0ull, [](uint64_t a, uint64_t b) {return a | b;});
+                break;
+            case COMPONENT_XOR_GATE :
+                gate_kernel(comp_id, 0, [](uint64_t a, uint64_t b) {return a ^ b;});
+                break;
+            case COMPONENT_XNOR_GATE :
+                gate_kernel(comp_id, ~0ull, [](uint64_t a, uint64_t b) {return a ^ b;});
+                break;
+            default :           // components without outputs or that never write to them (checked by init)
+                break;
+        }
+    }
+
+    // >> run simulation: oscillators (identical in all lanes)
+    for (auto &osc : m_oscillators) {
+        if (m_time >= osc.m_next_change) {
+            osc.m_value = osc.m_value == VALUE_TRUE ? VALUE_FALSE : VALUE_TRUE;
+            osc.m_next_change = m_time + osc.m_duration[osc.m_value];
+            drive_pin(osc.m_pin, lanes_broadcast(osc.m_value));
+        }
+    }
+
+    // >> user input
+    for (const auto &write : m_pending_writes) {
+        drive_pin(write.m_pin, write.m_values);
+    }
+    m_pending_writes.clear();
+
+    // >> post-process the dirty nodes
+    m_dirty_nodes_read.clear();
+    postprocess_dirty_nodes();
+}
+
+bool BitParallelSimulator::run_until_stable(size_t stable_ticks, size_t max_steps) {
+    assert(stable_ticks > 0);
+
+    auto remaining = stable_ticks;
+
+    for (size_t steps = 0; steps < max_steps; ++steps) {
+        step();
+
+        if (!m_dirty_nodes_read.empty()) {
+            remaining = stable_ticks;
+        } else if (--remaining == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void BitParallelSimulator::write_pin(pin_t pin, LaneValues values) {
+    assert(pin < m_pin_values.size());
+    m_pending_writes.push_back({pin, values});
+}
+
+void BitParallelSimulator::write_pin(pin_t pin, uint64_t data) {
+    write_pin(pin, LaneValues{data, 0});
+}
+
+void BitParallelSimulator::write_pin(pin_t pin, const value_container_t &values) {
+    write_pin(pin, lanes_from_values(values));
+}
+
+LaneValues BitParallelSimulator::read_pin(pin_t pin) const {
+    assert(pin < m_pin_values.size());
+    return m_node_values[m_sim->m_pin_nodes[pin]];
+}
+
+value_container_t BitParallelSimulator::read_pin_values(pin_t pin) const {
+    return lanes_to_values(read_pin(pin));
+}
+
+// any invalid input turns the output of the gate into VALUE_ERROR (for that lane)
+template <typename Reduce>
+void BitParallelSimulator::gate_kernel(uint32_t comp_id, uint64_t negate, Reduce reduce) {
+    auto pins = m_sim->component_pins(comp_id);
+    auto output_pin = m_sim->component_num_pins(comp_id) - 1;
+
+    auto input = read_pin(pins[0]);
+    auto value = input.m_bit0;
+    auto bad = input.m_bit1;
+    for (auto pin = 1u; pin < output_pin; ++pin) {
+        input = read_pin(pins[pin]);
+        value = reduce(value, input.m_bit0);
+        bad |= input.m_bit1;
+    }
+
+    drive_pin(pins[output_pin], {(value ^ negate) | bad, bad});
+}
+
+void BitParallelSimulator::drive_pin(pin_t pin, LaneValues values) {
+    // the pin stops driving its node in the lanes where it is undefined
+    auto active = values.m_bit0 | ~values.m_bit1;
+
+    auto &current = m_pin_values[pin];
+    if (current.m_bit0 == values.m_bit0 && current.m_bit1 == values.m_bit1 && m_pin_active[pin] == active) {
+        return;
+    }
+
+    current = values;
+    m_pin_active[pin] = active;
+
+    auto node_id = m_sim->m_pin_nodes[pin];
+    if (m_node_time_dirty_write[node_id] != m_time) {
+        m_node_time_dirty_write[node_id] = m_time;
+        m_dirty_nodes_write.push_back(node_id);
+    }
+}
+
+void BitParallelSimulator::postprocess_dirty_nodes() {
+
+    for (auto node_id : m_dirty_nodes_write) {
+        // count the active drivers in each lane: none, exactly one or multiple (contention)
+        uint64_t one = 0;
+        uint64_t many = 0;
+        LaneValues driven = {0, 0};
+
+        for (auto pin = m_node_drivers.row_begin(node_id); pin != m_node_drivers.row_end(node_id); ++pin) {
+            auto active = m_pin_active[*pin];
+            many |= one & active;
+            one |= active;
+            driven.m_bit0 |= m_pin_values[*pin].m_bit0 & active;
+            driven.m_bit1 |= m_pin_values[*pin].m_bit1 & active;
+        }
+
+        const auto &def = m_node_defaults[node_id];
+        LaneValues value = {
+            (driven.m_bit0 & one) | (def.m_bit0 & ~one) | many,
+            (driven.m_bit1 & one) | (def.m_bit1 & ~one) | many
+        };
+
+        auto &current = m_node_values[node_id];
+        if (current.m_bit0 != value.m_bit0 || current.m_bit1 != value.m_bit1) {
+            current = value;
+            m_dirty_nodes_read.push_back(node_id);
+        }
+    }
+
+    m_dirty_nodes_write.clear();
+}
+
+} // namespace lsim
@@ -0,0 +1,109 @@
+// sim_bit_parallel.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// simulates 64 independent copies (lanes) of the netlist at once, e.g. to run exhaustive test benches
+
+#ifndef LSIM_SIM_BIT_PARALLEL_H
+#define LSIM_SIM_BIT_PARALLEL_H
+
+#include "sim_types.h"
+
+namespace lsim {
+
+class Simulator;
+
+const size_t BIT_PARALLEL_LANES = 64;
+
+// the values of a node (or pin) in all lanes: lane N uses bit N of both planes. Like the Value enum,
+//  plane 0 holds the boolean value and plane 1 is set for undefined (0) or error (1) values.
+struct LaneValues {
+    uint64_t    m_bit0;
+    uint64_t    m_bit1;
+};
+
+inline LaneValues lanes_broadcast(Value value) {
+    return {(value & 1) ? ~0ull : 0ull, (value & 2) ? ~0ull : 0ull};
+}
+
+inline Value lanes_value(LaneValues lanes, size_t lane) {
+    return static_cast<Value>(((lanes.m_bit0 >> lane) & 1) | (((lanes.m_bit1 >> lane) & 1) << 1));
+}
+
+LaneValues lanes_from_values(const value_container_t &values);
+value_container_t lanes_to_values(LaneValues lanes);
+
+// the bit-parallel simulator shares the (frozen) netlist of a Simulator. init() initializes the simulator
+//  and copies its state to all lanes, after that each lane can be driven with different input values.
+//  Limitations: every component responds in one step (propagation delays are ignored), the logic gates,
+//  buffers, input connectors and oscillators are simulated - init() fails for circuits with other components
+//  (e.g. leds or lookup tables).
+class BitParallelSimulator {
+public:
+    explicit BitParallelSimulator(Simulator *sim);
+    BitParallelSimulator(const BitParallelSimulator &) = delete;
+
+    // simulation
+    bool init();
+    void step();
+    // false when no node stayed unchanged for 'stable_ticks' consecutive steps within 'max_steps' steps
+    bool run_until_stable(size_t stable_ticks, size_t max_steps = STEPS_UNLIMITED);
+    timestamp_t current_time() const {return m_time;}
+
+    // input from outside the circuit: the value of the pin in each lane, applied during the next step
+    void write_pin(pin_t pin, LaneValues values);
+    void write_pin(pin_t pin, uint64_t data);              // lane N: VALUE_TRUE if bit N is set, else VALUE_FALSE
+    void write_pin(pin_t pin, const value_container_t &values);
+
+    // value of the node the pin is connected to, in each lane
+    LaneValues read_pin(pin_t pin) const;
+    value_container_t read_pin_values(pin_t pin) const;
+
+private:
+    void build_topology();
+    template <typename Reduce>
+    void gate_kernel(uint32_t comp_id, uint64_t negate, Reduce reduce);
+    void drive_pin(pin_t pin, LaneValues values);
+    void postprocess_dirty_nodes();
+
+private:
+    using lanes_container_t = std::vector<LaneValues>;
+    using timestamp_container_t = std::vector<timestamp_t>;
+
+    struct Oscillator {
+        pin_t       m_pin;
+        Value       m_value;
+        timestamp_t m_next_change;
+        int64_t     m_duration[2];
+    };
+
+    struct PendingWrite {
+        pin_t       m_pin;
+        LaneValues  m_values;
+    };
+
+private:
+    Simulator *                 m_sim;
+    timestamp_t                 m_time = 0;
+
+    // components
+    std::vector<ComponentType>  m_component_types;
+    timestamp_container_t       m_input_changed;        // timestamp when component was last added to m_dirty_components
+    std::vector<uint32_t>       m_dirty_components;
+    std::vector<Oscillator>     m_oscillators;
+    std::vector<PendingWrite>   m_pending_writes;
+
+    // pins
+    lanes_container_t           m_pin_values;           // last value written to the pin
+    std::vector<uint64_t>       m_pin_active;           // lanes in which the pin is actively driving its node
+
+    // nodes
+    CsrArray<pin_t>             m_node_drivers;         // node-id => output pins connected to the node
+    lanes_container_t           m_node_defaults;
+    lanes_container_t           m_node_values;
+    timestamp_container_t       m_node_time_dirty_write;
+    node_container_t            m_dirty_nodes_read;     // nodes that were changed in the last step
+    node_container_t            m_dirty_nodes_write;    // nodes that were written to in the current step
+};
+
+} // namespace lsim
+
+#endif // LSIM_SIM_BIT_PARALLEL_H
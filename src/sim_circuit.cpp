@@ -18,44 +18,28 @@ SimCircuit::SimCircuit(Simulator *sim, ModelCircuit *circuit_desc) :
     assert(circuit_desc);
 }
 
-SimComponent *SimCircuit::add_component(ModelComponent *comp) {
-    assert(comp);
-    auto sim_comp = m_sim->create_component(comp);
-    m_components[comp->id()] = sim_comp;
-
-    if (comp->type() == COMPONENT_SUB_CIRCUIT) {
-        auto nested_instance = comp->nested_circuit()->instantiate(m_sim, false);
-        nested_instance->build_name(comp->id());
-
-        for (auto idx = 0u; idx < sim_comp->num_inputs(); ++idx) {
-            auto nested_pin = nested_instance->pin_from_pin_id(comp->nested_circuit()->port_by_index(true, idx));
-            m_sim->connect_pins(nested_pin, sim_comp->pin_by_index(sim_comp->input_pin_index(idx)));
-        }        
-
-        for (auto idx = 0u; idx < sim_comp->num_outputs(); ++idx) {
-            auto nested_pin = nested_instance->pin_from_pin_id(comp->nested_circuit()->port_by_index(false, idx));
-            m_sim->connect_pins(nested_pin, sim_comp->pin_by_index(sim_comp->output_pin_index(idx)));
-        }        
-
-        sim_comp->set_nested_instance(std::move(nested_instance));
-    }
-    return sim_comp;
+void SimCircuit::add_component(uint32_t comp_id, SimComponent *sim_comp) {
+    assert(sim_comp);
+    m_components[comp_id] = sim_comp;
 }
 
-node_t SimCircuit::add_wire(ModelWire *wire) {
-    assert(wire);
+std::unique_ptr<SimCircuit> SimCircuit::clone(Simulator *fork) const {
+    assert(fork);
+    assert(fork->num_components() == m_sim->num_components());
 
-    if (wire->num_pins() < 2) {
-        return NODE_INVALID;
-    }
+    auto result = std::make_unique<SimCircuit>(fork, m_circuit_desc);
+    result->m_name = m_name;
 
-    auto first_pin = pin_from_pin_id(wire->pin(0));
-    auto node = NODE_INVALID;
-    for (auto index = 1u; index < wire->num_pins(); ++index) {
-        node = m_sim->connect_pins(first_pin, pin_from_pin_id(wire->pin(index)));
+    for (const auto &entry : m_components) {
+        auto fork_comp = fork->component_by_id(entry.second->id());
+        result->m_components[entry.first] = fork_comp;
+
+        if (entry.second->nested_instance() != nullptr) {
+            fork_comp->set_nested_instance(entry.second->nested_instance()->clone(fork));
+        }
     }
 
-    return node;
+    return result;
 }
 
 void SimCircuit::connect_pins(pin_id_t pin_a, pin_id_t pin_b) {
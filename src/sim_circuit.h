@@ -17,11 +17,13 @@ public:
     ModelCircuit *description() const {return m_circuit_desc;}
 
     // instantiation
-    SimComponent *add_component(ModelComponent *comp);
-    node_t add_wire(ModelWire *wire);
+    void add_component(uint32_t comp_id, SimComponent *sim_comp);
     void connect_pins(pin_id_t pin_a, pin_id_t pin_b);
     SimComponent *component_by_id(uint32_t comp_id);
 
+    // the same circuit (including the nested circuits) in a fork of the simulator
+    std::unique_ptr<SimCircuit> clone(Simulator *fork) const;
+
     // name
     void build_name(uint32_t comp_id);
     const char *name() const {return m_name.c_str();}
@@ -51,7 +53,7 @@ public:
     Value pin_output(pin_id_t pin_id);
     Value user_value(pin_id_t pin_id);
 
-private: 
+    // pin in the simulator that corresponds with the pin_id in the circuit description
     pin_t pin_from_pin_id(pin_id_t pin_id);
 
 private:
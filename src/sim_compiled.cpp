@@ -0,0 +1,573 @@
+// sim_compiled.cpp - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// simulates the netlist with native code that is generated for the circuit and loaded as a shared library
+
+#include "sim_compiled.h"
+#include "simulator.h"
+#include "sim_component.h"
+#include "model_component.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#if defined(PLATFORM_WINDOWS) || defined(PLATFORM_EMSCRIPTEN)
+    #define LSIM_NATIVE_CODE 0
+#else
+    #define LSIM_NATIVE_CODE 1
+    #include <cerrno>
+    #include <cstring>
+    #include <dlfcn.h>
+    #include <fcntl.h>
+    #include <spawn.h>
+    #include <sys/stat.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    extern char **environ;
+#endif
+
+namespace {
+
+using namespace lsim;
+
+const char *STEP_FUNC_NAME = "lsim_step";
+
+// 64-bit FNV-1a
+uint64_t content_hash(const std::string &data, uint64_t hash = 0xcbf29ce484222325ull) {
+    for (auto c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string env_or_default(const char *name, const char *def) {
+    auto value = std::getenv(name);
+    return (value && *value) ? value : def;
+}
+
+#if LSIM_NATIVE_CODE
+
+// the cache holds code that is loaded into the process: it has to be private to the user
+std::string default_cache_dir() {
+    auto xdg_cache = env_or_default("XDG_CACHE_HOME", "");
+    if (!xdg_cache.empty()) {
+        return xdg_cache + "/lsim";
+    }
+    auto home = env_or_default("HOME", "");
+    return home.empty() ? std::string() : home + "/.cache/lsim";
+}
+
+// owned by the current user and not writable by anyone else
+bool is_private(const struct stat &info) {
+    return info.st_uid == getuid() && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// create the directory (and its parents) with mode 0700, an existing directory has to be private
+bool make_private_dir(const std::string &dir) {
+    for (auto sep = dir.find('/', 1); ; sep = dir.find('/', sep + 1)) {
+        auto path = dir.substr(0, sep);
+        if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+            ERROR_MSG("Unable to create directory %s: %s", path.c_str(), std::strerror(errno));
+            return false;
+        }
+        if (sep == std::string::npos) {
+            break;
+        }
+    }
+
+    struct stat info;
+    if (lstat(dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        ERROR_MSG("Cache directory %s isn't a directory", dir.c_str());
+        return false;
+    }
+    if (!is_private(info)) {
+        ERROR_MSG("Cache directory %s isn't owned by the current user or is writable by others", dir.c_str());
+        return false;
+    }
+    return true;
+}
+
+// a unique file name next to 'path', the file is created (empty) to reserve the name
+std::string reserve_temp_file(const std::string &path, const char *suffix) {
+    auto templ = path + ".XXXXXX" + suffix;
+    auto fd = mkstemps(&templ[0], static_cast<int>(std::strlen(suffix)));
+    if (fd < 0) {
+        ERROR_MSG("Unable to create a temporary file for %s: %s", path.c_str(), std::strerror(errno));
+        return std::string();
+    }
+    close(fd);
+    return templ;
+}
+
+bool write_file(const std::string &path, const std::string &data) {
+    auto fp = std::fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    auto written = std::fwrite(data.data(), 1, data.size(), fp);
+    return std::fclose(fp) == 0 && written == data.size();
+}
+
+// run the compiler without a shell (the paths can contain any character), its output goes to the log file
+bool run_compiler(const std::vector<std::string> &args, const std::string &log_path) {
+    std::vector<char *> argv;
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        return false;
+    }
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    pid_t pid;
+    auto spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+    if (!spawned) {
+        return false;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+#endif // LSIM_NATIVE_CODE
+
+// how the generated code resolves a node
+const uint8_t RESOLVE_HOST = 0;         // only driven by the host
+const uint8_t RESOLVE_ON_WRITE = 1;     // driven by buffers: resolved when one of them writes to the node
+const uint8_t RESOLVE_ALWAYS = 2;       // driven by a gate: the gates write their output every step
+
+bool is_gate(ComponentType type) {
+    return type >= COMPONENT_AND_GATE && type <= COMPONENT_XNOR_GATE;
+}
+
+bool is_buffer(ComponentType type) {
+    return type == COMPONENT_BUFFER || type == COMPONENT_TRISTATE_BUFFER;
+}
+
+// components with outputs that aren't part of the generated code
+bool is_host_component(ComponentType type) {
+    return type == COMPONENT_CONNECTOR_IN || type == COMPONENT_OSCILLATOR ||
+           type == COMPONENT_CONSTANT || type == COMPONENT_PULL_RESISTOR;         // these never write to their pin
+}
+
+// the generated code uses the same encoding as the Value enum: bit 0 holds the boolean state, bit 1 is set
+//  for an undefined or error value. Any invalid input turns the output of a gate into VALUE_ERROR.
+void emit_gate(std::ostream &out, ComponentType type, const node_t *inputs, size_t num_inputs, pin_t output) {
+    const char *reduce = "&";
+    int negate = 0;
+
+    switch (type) {
+        case COMPONENT_AND_GATE :  reduce = "&"; negate = 0; break;
+        case COMPONENT_OR_GATE :   reduce = "|"; negate = 0; break;
+        case COMPONENT_NOT_GATE :  reduce = "&"; negate = 1; break;
+        case COMPONENT_NAND_GATE : reduce = "&"; negate = 1; break;
+        case COMPONENT_NOR_GATE :  reduce = "|"; negate = 1; break;
+        case COMPONENT_XOR_GATE :  reduce = "^"; negate = 0; break;
+        case COMPONENT_XNOR_GATE : reduce = "^"; negate = 1; break;
+        default:
+            assert(false);
+    }
+
+    out << "    v = n[" << inputs[0] << "]";
+    for (size_t idx = 1; idx < num_inputs; ++idx) {
+        out << " " << reduce << " n[" << inputs[idx] << "]";
+    }
+    out << "; f = n[" << inputs[0] << "]";
+    for (size_t idx = 1; idx < num_inputs; ++idx) {
+        out << " | n[" << inputs[idx] << "]";
+    }
+    out << "; p[" << output << "] = (f & 2) ? 3 : ((v & 1) ^ " << negate << "); a[" << output << "] = 1;\n";
+}
+
+} // unnamed namespace
+
+namespace lsim {
+
+CompiledSimulator::CompiledSimulator(Simulator *sim) :
+        m_sim(sim) {
+    assert(sim);
+}
+
+CompiledSimulator::~CompiledSimulator() {
+#if LSIM_NATIVE_CODE
+    if (m_library) {
+        dlclose(m_library);
+    }
+#endif
+}
+
+void CompiledSimulator::build_topology() {
+    m_sim->finalize();
+
+    auto num_pins = m_sim->m_pin_nodes.size();
+    auto num_nodes = m_sim->m_node_values_read.size();
+
+    m_pin_values.assign(num_pins, VALUE_UNDEFINED);
+    m_pin_active.assign(num_pins, 0);
+
+    m_node_values.assign(num_nodes, VALUE_UNDEFINED);
+    m_node_defaults.assign(num_nodes, VALUE_UNDEFINED);
+    m_node_resolve.assign(num_nodes, RESOLVE_HOST);
+
+    // only the output pins of the components ever drive a node
+    std::vector<pin_container_t> drivers(num_nodes);
+
+    for (auto &comp : m_sim->m_components) {
+        auto type = comp.description()->type();
+
+        for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+            auto pin = comp.pin_by_index(comp.output_pin_index(idx));
+            auto node_id = m_sim->m_pin_nodes[pin];
+            drivers[node_id].push_back(pin);
+            if (is_gate(type)) {
+                m_node_resolve[node_id] = RESOLVE_ALWAYS;
+            } else if (is_buffer(type)) {
+                m_node_resolve[node_id] = std::max(m_node_resolve[node_id], RESOLVE_ON_WRITE);
+            }
+        }
+    }
+
+    m_node_drivers.clear();
+    for (const auto &pins : drivers) {
+        m_node_drivers.append_row(std::begin(pins), std::end(pins));
+    }
+}
+
+std::string CompiledSimulator::generate_source() {
+    build_topology();
+
+    std::ostringstream out;
+
+    out << "// generated by lsim - do not edit\n"
+        << "#include <stddef.h>\n"
+        << "#include <stdint.h>\n\n"
+        << "extern \"C\" size_t " << STEP_FUNC_NAME
+        << "(uint8_t *n, uint8_t *p, uint8_t *a, const uint8_t *d) {\n"
+        << "    uint8_t v, f;\n"
+        << "    unsigned k;\n"
+        << "    size_t c = 0;\n";
+
+    for (node_t node_id = 0; node_id < m_node_values.size(); ++node_id) {
+        if (m_node_resolve[node_id] == RESOLVE_ON_WRITE) {
+            out << "    bool w" << node_id << " = false;\n";
+        }
+    }
+    out << "\n";
+
+    // a buffer that keeps not driving its node doesn't write to it (like buffer_write in sim_gates.cpp)
+    auto emit_buffer_write = [&](pin_t output) {
+        auto node_id = m_sim->m_pin_nodes[output];
+        if (m_node_resolve[node_id] == RESOLVE_ON_WRITE) {
+            out << " w" << node_id << " |= v != 2 || p[" << output << "] != 2;";
+        }
+        out << " p[" << output << "] = v; a[" << output << "] = v != 2;\n";
+    };
+
+    // >> the gates: compute the new output values from the node values of the previous step
+    std::vector<node_t> inputs;
+
+    for (auto &comp : m_sim->m_components) {
+        auto type = comp.description()->type();
+        auto pins = m_sim->component_pins(comp.id());
+        auto num_pins = m_sim->component_num_pins(comp.id());
+
+        if (is_gate(type)) {
+            inputs.clear();
+            for (auto idx = 0u; idx < num_pins - 1; ++idx) {
+                inputs.push_back(m_sim->m_pin_nodes[pins[idx]]);
+            }
+            emit_gate(out, type, inputs.data(), inputs.size(), pins[num_pins - 1]);
+        } else if (type == COMPONENT_BUFFER) {
+            auto num_inputs = num_pins / 2;
+            for (auto idx = 0u; idx < num_inputs; ++idx) {
+                out << "    v = n[" << m_sim->m_pin_nodes[pins[idx]] << "];";
+                emit_buffer_write(pins[num_inputs + idx]);
+            }
+        } else if (type == COMPONENT_TRISTATE_BUFFER) {
+            auto num_inputs = (num_pins - 1) / 2;
+            auto control = m_sim->m_pin_nodes[pins[2 * num_inputs]];
+            for (auto idx = 0u; idx < num_inputs; ++idx) {
+                out << "    v = n[" << control << "] == 1 ? n[" << m_sim->m_pin_nodes[pins[idx]] << "] : 2;";
+                emit_buffer_write(pins[num_inputs + idx]);
+            }
+        } else if (comp.num_outputs() > 0 && !is_host_component(type)) {
+            ERROR_MSG("Component type 0x%04x can't be compiled to native code", type);
+            return std::string();
+        }
+    }
+
+    // >> resolve the nodes driven by the gates and buffers
+    out << "\n";
+
+    for (node_t node_id = 0; node_id < m_node_values.size(); ++node_id) {
+        if (m_node_resolve[node_id] == RESOLVE_HOST) {
+            continue;
+        }
+
+        out << (m_node_resolve[node_id] == RESOLVE_ON_WRITE ? "    if (w" + std::to_string(node_id) + ")" : "");
+
+        auto first = m_node_drivers.row_begin(node_id);
+        auto last = m_node_drivers.row_end(node_id);
+
+        if (last - first == 1) {
+            out << " { v = a[" << *first << "] ? p[" << *first << "] : d[" << node_id << "];";
+        } else {
+            out << " { k = a[" << *first << "]";
+            for (auto pin = first + 1; pin != last; ++pin) {
+                out << " + a[" << *pin << "]";
+            }
+            out << "; v = k == 0 ? d[" << node_id << "] : k > 1 ? 3 : ";
+            for (auto pin = first; pin != last - 1; ++pin) {
+                out << "a[" << *pin << "] ? p[" << *pin << "] : ";
+            }
+            out << "p[" << *(last - 1) << "];";
+        }
+        out << " c += v != n[" << node_id << "]; n[" << node_id << "] = v; }\n";
+    }
+
+    out << "\n    return c;\n}\n";
+
+    return out.str();
+}
+
+bool CompiledSimulator::compile(const char *cache_dir) {
+#if LSIM_NATIVE_CODE
+    auto source = generate_source();
+    if (source.empty()) {
+        return false;
+    }
+
+    // the name of the library depends on the generated code and on how it is compiled
+    std::vector<std::string> args = {env_or_default("LSIM_CXX", "c++"), "-O2", "-shared", "-fPIC"};
+    std::string command;
+    for (const auto &arg : args) {
+        command += arg + " ";
+    }
+
+    std::string dir = cache_dir ? cache_dir : env_or_default("LSIM_CACHE_DIR", "");
+    if (dir.empty()) {
+        dir = default_cache_dir();
+    }
+    if (dir.empty()) {
+        ERROR_MSG("No cache directory for the generated code (set LSIM_CACHE_DIR or HOME)%s", "");
+        return false;
+    }
+    if (!make_private_dir(dir)) {
+        return false;
+    }
+
+    char hash_str[17];
+    std::snprintf(hash_str, sizeof(hash_str), "%016" PRIx64, content_hash(source, content_hash(command)));
+    auto base_path = dir + "/lsim_" + hash_str;
+    auto lib_path = base_path + ".so";
+
+    struct stat lib_info;
+    m_from_cache = lstat(lib_path.c_str(), &lib_info) == 0;
+
+    if (!m_from_cache) {
+        // write and build to temporary files first: concurrent processes never see partially written files
+        auto src_path = base_path + ".cpp";
+        auto tmp_src_path = reserve_temp_file(base_path, ".cpp");
+        auto tmp_lib_path = reserve_temp_file(base_path, ".so");
+        if (tmp_src_path.empty() || tmp_lib_path.empty()) {
+            std::remove(tmp_src_path.c_str());
+            std::remove(tmp_lib_path.c_str());
+            return false;
+        }
+
+        if (!write_file(tmp_src_path, source) || std::rename(tmp_src_path.c_str(), src_path.c_str()) != 0) {
+            ERROR_MSG("Unable to write generated code to %s", src_path.c_str());
+            std::remove(tmp_src_path.c_str());
+            std::remove(tmp_lib_path.c_str());
+            return false;
+        }
+
+        args.insert(args.end(), {"-o", tmp_lib_path, src_path});
+        if (!run_compiler(args, base_path + ".log")) {
+            ERROR_MSG("Compilation of generated code failed (see %s.log)", base_path.c_str());
+            std::remove(tmp_lib_path.c_str());
+            return false;
+        }
+
+        // the linker creates the library with the permissions of the umask
+        if (chmod(tmp_lib_path.c_str(), 0700) != 0 || std::rename(tmp_lib_path.c_str(), lib_path.c_str()) != 0) {
+            ERROR_MSG("Unable to move the compiled code to %s: %s", lib_path.c_str(), std::strerror(errno));
+            std::remove(tmp_lib_path.c_str());
+            return false;
+        }
+
+        if (lstat(lib_path.c_str(), &lib_info) != 0) {
+            ERROR_MSG("Unable to find the compiled code in %s", lib_path.c_str());
+            return false;
+        }
+    }
+
+    // only load a library that the current user created
+    if (!S_ISREG(lib_info.st_mode) || !is_private(lib_info)) {
+        ERROR_MSG("Refusing to load %s: not a regular file owned by the current user or writable by others",
+                  lib_path.c_str());
+        return false;
+    }
+
+    // load the library
+    auto library = dlopen(lib_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        ERROR_MSG("Unable to load %s: %s", lib_path.c_str(), dlerror());
+        return false;
+    }
+
+    auto step_func = reinterpret_cast<step_func_t>(dlsym(library, STEP_FUNC_NAME));
+    if (!step_func) {
+        ERROR_MSG("Unable to find %s in %s", STEP_FUNC_NAME, lib_path.c_str());
+        dlclose(library);
+        return false;
+    }
+
+    if (m_library) {
+        dlclose(m_library);
+    }
+    m_library = library;
+    m_step_func = step_func;
+    m_library_path = lib_path;
+    return true;
+#else
+    ERROR_MSG("Native code generation is not supported on this platform%s", "");
+    return false;
+#endif
+}
+
+void CompiledSimulator::init() {
+    assert(is_compiled());
+
+    m_sim->init();
+    m_time = m_sim->m_time;
+
+    // start from the initial state of the interpreting simulator
+    for (size_t pin = 0; pin < m_pin_values.size(); ++pin) {
+        m_pin_values[pin] = m_sim->m_pin_values[pin];
+        m_pin_active[pin] = m_sim->m_pin_active[pin];
+    }
+
+    for (size_t node = 0; node < m_node_values.size(); ++node) {
+        m_node_values[node] = m_sim->m_node_values_read[node];
+        m_node_defaults[node] = m_sim->m_node_defaults[node];
+    }
+
+    m_pending_writes.clear();
+    m_num_changed = m_node_values.size();
+
+    m_oscillators.clear();
+    for (auto &comp : m_sim->m_components) {
+        if (comp.description()->type() == COMPONENT_OSCILLATOR) {
+            auto *extra = reinterpret_cast<ExtraDataOscillator *>(comp.extra_data());
+            auto pin = comp.pin_by_index(comp.output_pin_index(0));
+            m_oscillators.push_back({pin, extra->m_next_change, {extra->m_duration[0], extra->m_duration[1]}});
+        }
+    }
+}
+
+void CompiledSimulator::step() {
+    assert(is_compiled());
+
+    m_time = m_time + 1;
+    m_host_dirty_nodes.clear();
+
+    // >> the components simulated by the host write their pins before the native code resolves the nodes
+    for (auto &osc : m_oscillators) {
+        if (m_time >= osc.m_next_change) {
+            auto value = m_pin_values[osc.m_pin] == VALUE_TRUE ? VALUE_FALSE : VALUE_TRUE;
+            osc.m_next_change = m_time + osc.m_duration[value];
+            drive_pin(osc.m_pin, value);
+        }
+    }
+
+    for (const auto &write : m_pending_writes) {
+        if (m_pin_values[write.m_pin] != write.m_value || write.m_value != VALUE_UNDEFINED) {
+            drive_pin(write.m_pin, write.m_value);
+        }
+    }
+    m_pending_writes.clear();
+
+    // >> the gates
+    m_num_changed = m_step_func(m_node_values.data(), m_pin_values.data(), m_pin_active.data(), m_node_defaults.data());
+
+    // >> nodes that aren't resolved by the native code in every step
+    for (auto node_id : m_host_dirty_nodes) {
+        if (m_node_resolve[node_id] != RESOLVE_ALWAYS) {
+            resolve_node(node_id);
+        }
+    }
+}
+
+bool CompiledSimulator::run_until_stable(size_t stable_ticks, size_t max_steps) {
+    assert(stable_ticks > 0);
+
+    auto remaining = stable_ticks;
+
+    for (size_t steps = 0; steps < max_steps; ++steps) {
+        step();
+
+        if (m_num_changed > 0) {
+            remaining = stable_ticks;
+        } else if (--remaining == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CompiledSimulator::write_pin(pin_t pin, Value value) {
+    assert(pin < m_pin_values.size());
+    m_pending_writes.push_back({pin, value});
+}
+
+Value CompiledSimulator::read_pin(pin_t pin) const {
+    assert(pin < m_pin_values.size());
+    return static_cast<Value>(m_node_values[m_sim->m_pin_nodes[pin]]);
+}
+
+void CompiledSimulator::drive_pin(pin_t pin, Value value) {
+    m_pin_values[pin] = value;
+    m_pin_active[pin] = value != VALUE_UNDEFINED;
+    m_host_dirty_nodes.push_back(m_sim->m_pin_nodes[pin]);
+}
+
+void CompiledSimulator::resolve_node(node_t node_id) {
+    size_t active = 0;
+    auto value = m_node_defaults[node_id];
+
+    for (auto pin = m_node_drivers.row_begin(node_id); pin != m_node_drivers.row_end(node_id); ++pin) {
+        if (m_pin_active[*pin]) {
+            active += 1;
+            value = m_pin_values[*pin];
+        }
+    }
+
+    if (active > 1) {
+        value = VALUE_ERROR;
+    }
+
+    if (m_node_values[node_id] != value) {
+        m_node_values[node_id] = value;
+        m_num_changed += 1;
+    }
+}
+
+} // namespace lsim
@@ -0,0 +1,106 @@
+// sim_compiled.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// simulates the netlist with native code that is generated for the circuit and loaded as a shared library
+
+#ifndef LSIM_SIM_COMPILED_H
+#define LSIM_SIM_COMPILED_H
+
+#include "sim_types.h"
+
+#include <string>
+
+namespace lsim {
+
+class Simulator;
+
+// the compiled simulator shares the (frozen) netlist of a Simulator. compile() generates straight-line C++
+//  for the netlist (one statement per gate), builds it with the system compiler and loads the result with
+//  dlopen. The shared libraries are cached by the hash of the generated code, so a circuit is only compiled
+//  once. init() initializes the simulator and copies its state, after that the simulation runs natively.
+//  Limitations: every component responds in one step (propagation delays are ignored), the logic gates,
+//  buffers, input connectors and oscillators are simulated - other components (e.g. leds) are not.
+class CompiledSimulator {
+public:
+    explicit CompiledSimulator(Simulator *sim);
+    CompiledSimulator(const CompiledSimulator &) = delete;
+    ~CompiledSimulator();
+
+    // compile (or load from the cache) the native code for the netlist, returns false if this isn't possible
+    //  - the compiler can be overridden with the LSIM_CXX environment variable (a program, run without a shell)
+    //  - the cache directory defaults to $LSIM_CACHE_DIR, $XDG_CACHE_HOME/lsim or ~/.cache/lsim. It's created with
+    //    mode 0700, the directory and the libraries have to be owned by the user and not writable by others.
+    bool compile(const char *cache_dir = nullptr);
+    bool is_compiled() const {return m_step_func != nullptr;}
+    const std::string &library_path() const {return m_library_path;}
+    bool loaded_from_cache() const {return m_from_cache;}
+
+    // the generated code, compile() calls this too
+    std::string generate_source();
+
+    // simulation
+    void init();
+    void step();
+    // false when no node stayed unchanged for 'stable_ticks' consecutive steps within 'max_steps' steps
+    bool run_until_stable(size_t stable_ticks, size_t max_steps = STEPS_UNLIMITED);
+    timestamp_t current_time() const {return m_time;}
+
+    // input from outside the circuit, applied during the next step
+    void write_pin(pin_t pin, Value value);
+
+    // value of the node the pin is connected to
+    Value read_pin(pin_t pin) const;
+
+public:
+    // signature of the generated function: evaluates all the gates and resolves the nodes they drive.
+    //  Returns the number of nodes that changed value.
+    using step_func_t = size_t (*)(uint8_t *nodes, uint8_t *pins, uint8_t *active, const uint8_t *defaults);
+
+private:
+    void build_topology();
+    void resolve_node(node_t node_id);
+    void drive_pin(pin_t pin, Value value);
+
+private:
+    struct Oscillator {
+        pin_t       m_pin;
+        timestamp_t m_next_change;
+        int64_t     m_duration[2];
+    };
+
+    struct PendingWrite {
+        pin_t       m_pin;
+        Value       m_value;
+    };
+
+    using byte_container_t = std::vector<uint8_t>;
+
+private:
+    Simulator *                 m_sim;
+    timestamp_t                 m_time = 0;
+
+    // native code
+    void *                      m_library = nullptr;
+    step_func_t                 m_step_func = nullptr;
+    std::string                 m_library_path;
+    bool                        m_from_cache = false;
+
+    // components that are simulated by the host: they write to pins in between the calls to the native code
+    std::vector<Oscillator>     m_oscillators;
+    std::vector<PendingWrite>   m_pending_writes;
+
+    // pins
+    byte_container_t            m_pin_values;
+    byte_container_t            m_pin_active;
+
+    // nodes
+    CsrArray<pin_t>             m_node_drivers;         // node-id => output pins connected to the node
+    byte_container_t            m_node_resolve;         // when the native code resolves the node
+    byte_container_t            m_node_defaults;
+    byte_container_t            m_node_values;
+    node_container_t            m_host_dirty_nodes;     // nodes written by the host in the current step
+    size_t                      m_num_changed = 0;      // nodes that changed value in the last step
+};
+
+} // namespace lsim
+
+#endif // LSIM_SIM_COMPILED_H
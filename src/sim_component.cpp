@@ -3,6 +3,7 @@
 #include "sim_component.h"
 #include "sim_circuit.h"
 #include "simulator.h"
+#include <algorithm>
 #include <cassert>
 
 namespace lsim {
@@ -11,69 +12,86 @@ SimComponent::SimComponent(Simulator* sim, ModelComponent* comp, uint32_t id) :
 	m_sim(sim),
 	m_comp_desc(comp),
 	m_id(id),
+	m_user_values(ARENA_NONE),
+	m_extra_data(ARENA_NONE),
+	m_extra_data_size(0),
+	m_output_start(comp->num_inputs()),
+	m_control_start(comp->num_inputs() + comp->num_outputs()),
 	m_read_bad(false),
 	m_nested_circuit(nullptr) {
+}
 
-	auto num_pins = comp->num_inputs() + comp->num_outputs() + comp->num_controls();
-	m_output_start = comp->num_inputs();
-	m_control_start = m_output_start + comp->num_outputs();
-	for (size_t idx = 0; idx < num_pins; ++idx) {
-		m_pins.push_back(sim->assign_pin(this, idx < m_output_start || idx >= m_control_start));
-	}
+SimComponent::SimComponent(Simulator* sim, const SimComponent& other) :
+	m_sim(sim),
+	m_comp_desc(other.m_comp_desc),
+	m_id(other.m_id),
+	m_user_values(other.m_user_values),
+	m_extra_data(other.m_extra_data),
+	m_extra_data_size(other.m_extra_data_size),
+	m_output_start(other.m_output_start),
+	m_control_start(other.m_control_start),
+	m_read_bad(false),
+	m_nested_circuit(nullptr) {
 }
 
 void SimComponent::apply_initial_values() {
 	auto initial_out = m_comp_desc->property_value("initial_output", VALUE_UNDEFINED);
 	if (initial_out != VALUE_UNDEFINED) {
 		for (size_t pin = m_output_start; pin < m_control_start; ++pin) {
-			m_sim->pin_set_initial_value(m_pins[pin], initial_out);
+			m_sim->pin_set_initial_value(pin_by_index(pin), initial_out);
 		}
 	}
 
 	if (m_comp_desc->type() == COMPONENT_CONNECTOR_IN &&
-		!m_user_values.empty() &&
+		user_values_enabled() &&
 		!m_comp_desc->property_value("tri_state", false)) {
 		for (size_t pin = m_output_start; pin < m_control_start; ++pin) {
-			m_user_values[pin] = VALUE_FALSE;
-			m_sim->pin_set_initial_value(m_pins[pin], initial_out);
+			m_sim->user_values(m_user_values)[pin] = VALUE_FALSE;
+			m_sim->pin_set_initial_value(pin_by_index(pin), initial_out);
 		}
 	}
 }
 
+const pin_t* SimComponent::pins() const {
+	return m_sim->component_pins(m_id);
+}
+
+size_t SimComponent::num_pins() const {
+	return m_sim->component_num_pins(m_id);
+}
+
 pin_t SimComponent::pin_by_index(uint32_t index) const {
-	assert(index < m_pins.size());
-	return m_pins[index];
+	assert(index < num_pins());
+	return pins()[index];
 }
 
 pin_container_t SimComponent::input_pins() const {
-	return pin_container_t(m_pins.begin(), m_pins.begin() + m_output_start);
+	return pin_container_t(pins(), pins() + m_output_start);
 }
 
 pin_container_t SimComponent::output_pins() const {
-	return pin_container_t(m_pins.begin() + m_output_start, m_pins.begin() + m_control_start);
+	return pin_container_t(pins() + m_output_start, pins() + m_control_start);
 }
 
 pin_container_t SimComponent::control_pins() const {
-	return pin_container_t(m_pins.begin() + m_control_start, m_pins.end());
+	return pin_container_t(pins() + m_control_start, pins() + num_pins());
 }
 
 Value SimComponent::read_pin(uint32_t index) const {
-	assert(index < m_pins.size());
-	return m_sim->read_pin(m_pins[index]);
+	return m_sim->read_pin(pin_by_index(index));
 }
 
 void SimComponent::write_pin(uint32_t index, Value value) {
-	assert(index < m_pins.size());
+	auto pin = pin_by_index(index);
 	// XXX: is the second test really necessary?
-	if (value == VALUE_UNDEFINED && m_sim->pin_output_value(m_pins[index]) == value) {
+	if (value == VALUE_UNDEFINED && m_sim->pin_stays_undefined(pin)) {
 		return;
 	}
-	m_sim->write_pin(m_pins[index], value);
+	m_sim->write_pin(pin, value);
 }
 
 bool SimComponent::read_pin_checked(uint32_t index) {
-	assert(index < m_pins.size());
-	auto value = m_sim->read_pin(m_pins[index]);
+	auto value = m_sim->read_pin(pin_by_index(index));
 	m_read_bad |= (value != VALUE_TRUE && value != VALUE_FALSE);
 	return static_cast<bool>(value);
 }
@@ -84,20 +102,23 @@ void SimComponent::write_pin_checked(uint32_t index, bool value) {
 }
 
 void SimComponent::enable_user_values() {
-	m_user_values.clear();
-	m_user_values.resize(m_pins.size(), VALUE_UNDEFINED);
+	if (m_user_values == ARENA_NONE) {
+		m_user_values = m_sim->allocate_user_values(num_pins());
+	}
+	std::fill_n(m_sim->user_values(m_user_values), num_pins(), VALUE_UNDEFINED);
 }
 
 Value SimComponent::user_value(uint32_t index) const {
-	if (index < m_user_values.size()) {
-		return m_user_values[index];
+	if (m_user_values != ARENA_NONE && index < num_pins()) {
+		return m_sim->user_values(m_user_values)[index];
 	}
 	return VALUE_UNDEFINED;
 }
 
 void SimComponent::set_user_value(uint32_t index, Value value) {
-	assert(index < m_pins.size());
-	m_user_values[index] = value;
+	assert(m_user_values != ARENA_NONE);
+	assert(index < num_pins());
+	m_sim->user_values(m_user_values)[index] = value;
 	m_sim->activate_independent_simulation_func(this);
 }
 
@@ -105,4 +126,17 @@ void SimComponent::set_nested_instance(std::unique_ptr<class SimCircuit> instanc
 	m_nested_circuit = std::move(instance);
 }
 
+void SimComponent::set_extra_data_size(size_t size) {
+	// setup functions run on every init: reuse the previous allocation when it is large enough
+	if (m_extra_data == ARENA_NONE || size > m_extra_data_size) {
+		m_extra_data = m_sim->allocate_extra_data(size);
+		m_extra_data_size = static_cast<uint32_t>(size);
+	}
+}
+
+uint8_t* SimComponent::extra_data() {
+	assert(m_extra_data != ARENA_NONE);
+	return m_sim->extra_data(m_extra_data);
+}
+
 } // namespace lsim
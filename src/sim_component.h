@@ -11,11 +11,14 @@ namespace lsim {
 
 class Simulator;
 
+const uint32_t ARENA_NONE = static_cast<uint32_t>(-1);
+
+// SimComponent is a lightweight handle: the simulator stores the components in one container and keeps their
+//  pins, user values and extra data in shared arenas. The pins of a component are assigned by the simulator.
 class SimComponent {
-public:
-	using uptr_t = std::unique_ptr<SimComponent>;
 public:
 	SimComponent(Simulator* sim, ModelComponent* comp, uint32_t id);
+	SimComponent(Simulator* sim, const SimComponent& other);		// the same component in a fork of the simulator
 	ModelComponent* description() const { return m_comp_desc; }
 	uint32_t id() const { return m_id; }
 
@@ -26,13 +29,14 @@ public:
 	uint32_t input_pin_index(uint32_t index) const { return index; }
 	uint32_t output_pin_index(uint32_t index) const { return m_output_start + index; }
 	uint32_t control_pin_index(uint32_t index) const { return m_control_start + index; }
-	const pin_container_t& pins() const { return m_pins; }
+	const pin_t* pins() const;
+	size_t num_pins() const;
 	pin_container_t input_pins() const;
 	pin_container_t output_pins() const;
 	pin_container_t control_pins() const;
 	size_t num_inputs() const { return m_output_start; }
 	size_t num_outputs() const { return m_control_start - m_output_start; }
-	size_t num_controls() const { return m_pins.size() - m_control_start; }
+	size_t num_controls() const { return num_pins() - m_control_start; }
 
 	// read/write_pin: read/write the value of the node the specified pin connects to
 	Value read_pin(uint32_t index) const;
@@ -49,24 +53,25 @@ public:
 	void enable_user_values();
 	Value user_value(uint32_t index) const;
 	void set_user_value(uint32_t index, Value value);
-	bool user_values_enabled() const { return !m_user_values.empty(); }
+	bool user_values_enabled() const { return m_user_values != ARENA_NONE; }
 
 	// nested circuits
 	void set_nested_instance(std::unique_ptr<SimCircuit> instance);
 	SimCircuit* nested_instance() const { return m_nested_circuit.get(); }
 
 	// extra-data: component specific data structure
-	void set_extra_data_size(size_t size) { m_extra_data.resize(size); };
-	uint8_t* extra_data() { return m_extra_data.data(); }
+	//  (the pointer is only valid until the next component allocates its extra data)
+	void set_extra_data_size(size_t size);
+	uint8_t* extra_data();
 
 private:
 	Simulator* m_sim;
 	ModelComponent* m_comp_desc;
 	uint32_t m_id;
 
-	pin_container_t m_pins;
-	value_container_t m_user_values;
-	std::vector<uint8_t> m_extra_data;
+	uint32_t m_user_values;		// offset in the user values arena of the simulator (or ARENA_NONE)
+	uint32_t m_extra_data;		// offset in the extra data arena of the simulator (or ARENA_NONE)
+	uint32_t m_extra_data_size;
 
 	uint32_t m_output_start;
 	uint32_t m_control_start;
@@ -0,0 +1,136 @@
+// sim_condition.cpp - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// stop conditions for Simulator::run, evaluated on the nodes that changed value
+
+#include "sim_condition.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace lsim {
+
+RunCondition &RunCondition::node_value(node_t node_id, Value value) {
+    add_term(CONDITION_NODE_VALUE, &node_id, 1, value, 0);
+    return *this;
+}
+
+RunCondition &RunCondition::rising_edge(node_t node_id) {
+    add_term(CONDITION_RISING_EDGE, &node_id, 1, VALUE_TRUE, 0);
+    return *this;
+}
+
+RunCondition &RunCondition::falling_edge(node_t node_id) {
+    add_term(CONDITION_FALLING_EDGE, &node_id, 1, VALUE_FALSE, 0);
+    return *this;
+}
+
+RunCondition &RunCondition::bus_value(const node_container_t &nodes, uint64_t value, uint64_t mask) {
+    assert(!nodes.empty());
+    assert(nodes.size() <= 64);
+
+    if (nodes.size() < 64) {
+        mask &= (1ull << nodes.size()) - 1;
+    }
+    add_term(CONDITION_BUS_VALUE, nodes.data(), nodes.size(), value & mask, mask);
+    return *this;
+}
+
+void RunCondition::add_term(ConditionType type, const node_t *nodes, size_t num_nodes, uint64_t value, uint64_t mask) {
+    m_terms.push_back({type, static_cast<uint32_t>(m_nodes.size()), static_cast<uint32_t>(num_nodes), value, mask});
+    m_nodes.insert(m_nodes.end(), nodes, nodes + num_nodes);
+}
+
+ConditionMonitor::ConditionMonitor(const Simulator *sim, const RunCondition &condition) :
+        m_sim(sim),
+        m_condition(condition),
+        m_node_watched(sim->num_nodes(), 0) {
+
+    auto num_terms = condition.m_terms.size();
+    m_state.resize(num_terms);
+    m_checked.assign(num_terms, 0);
+
+    for (size_t term = 0; term < num_terms; ++term) {
+        const auto &t = condition.m_terms[term];
+        for (auto idx = t.m_first_node; idx < t.m_first_node + t.m_num_nodes; ++idx) {
+            auto node_id = condition.m_nodes[idx];
+            assert(node_id < m_node_watched.size());
+            m_node_watched[node_id] = true;
+            m_node_terms.push_back({node_id, static_cast<uint32_t>(term)});
+        }
+        m_state[term] = evaluate(term);
+    }
+
+    std::sort(m_node_terms.begin(), m_node_terms.end());
+}
+
+bool ConditionMonitor::check(const node_container_t &changed) {
+    m_num_checks += 1;
+    m_met_term = TERM_NONE;
+
+    for (auto node_id : changed) {
+        if (!m_node_watched[node_id]) {
+            continue;
+        }
+
+        auto first = std::lower_bound(m_node_terms.begin(), m_node_terms.end(), std::make_pair(node_id, uint32_t(0)));
+        for (auto entry = first; entry != m_node_terms.end() && entry->first == node_id; ++entry) {
+            auto term = entry->second;
+            if (m_checked[term] == m_num_checks) {
+                continue;
+            }
+            m_checked[term] = m_num_checks;
+            if (update(term) && term < m_met_term) {
+                m_met_term = term;
+            }
+        }
+    }
+
+    return m_met_term != TERM_NONE;
+}
+
+uint64_t ConditionMonitor::evaluate(size_t term) const {
+    const auto &t = m_condition.m_terms[term];
+    const auto *nodes = m_condition.m_nodes.data() + t.m_first_node;
+
+    switch (t.m_type) {
+        case CONDITION_NODE_VALUE :
+            return m_sim->read_node(nodes[0]) == t.m_value;
+        case CONDITION_RISING_EDGE :
+        case CONDITION_FALLING_EDGE :
+            return m_sim->read_node(nodes[0]);
+        case CONDITION_BUS_VALUE : {
+            uint64_t data = 0;
+            for (auto bit = 0u; bit < t.m_num_nodes; ++bit) {
+                if (((t.m_mask >> bit) & 1) == 0) {
+                    continue;
+                }
+                auto value = m_sim->read_node(nodes[bit]);
+                if (value != VALUE_TRUE && value != VALUE_FALSE) {
+                    return false;
+                }
+                data |= static_cast<uint64_t>(value) << bit;
+            }
+            return data == t.m_value;
+        }
+    }
+
+    return 0;
+}
+
+bool ConditionMonitor::update(size_t term) {
+    auto previous = m_state[term];
+    auto current = evaluate(term);
+    m_state[term] = current;
+
+    switch (m_condition.m_terms[term].m_type) {
+        case CONDITION_RISING_EDGE :
+            return previous == VALUE_FALSE && current == VALUE_TRUE;
+        case CONDITION_FALLING_EDGE :
+            return previous == VALUE_TRUE && current == VALUE_FALSE;
+        default :
+            return !previous && current;
+    }
+}
+
+} // namespace lsim
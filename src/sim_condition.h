@@ -0,0 +1,86 @@
+// sim_condition.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// stop conditions for Simulator::run, evaluated on the nodes that changed value
+
+#ifndef LSIM_SIM_CONDITION_H
+#define LSIM_SIM_CONDITION_H
+
+#include "sim_types.h"
+
+namespace lsim {
+
+class Simulator;
+
+// index of the term of a condition that wasn't met
+const size_t TERM_NONE = static_cast<size_t>(-1);
+
+enum ConditionType {
+    CONDITION_NODE_VALUE = 0,       // node changes to a value
+    CONDITION_RISING_EDGE,          // node changes from false to true
+    CONDITION_FALLING_EDGE,         // node changes from true to false
+    CONDITION_BUS_VALUE,            // a group of nodes changes to a bit pattern
+};
+
+// a condition is met as soon as one of its terms is met. The terms react to a change: a term that is already
+//  true when the run starts doesn't stop it (until its nodes change and it becomes true again).
+class RunCondition {
+public:
+    RunCondition &node_value(node_t node_id, Value value);
+    RunCondition &rising_edge(node_t node_id);
+    RunCondition &falling_edge(node_t node_id);
+
+    // bit 'i' of the pattern is the value of nodes[i], only the bits set in 'mask' are compared.
+    //  A node that isn't a valid boolean (undefined or error) never matches.
+    RunCondition &bus_value(const node_container_t &nodes, uint64_t value, uint64_t mask = ~0ull);
+
+    bool empty() const {return m_terms.empty();}
+    size_t num_terms() const {return m_terms.size();}
+
+private:
+    struct Term {
+        ConditionType   m_type;
+        uint32_t        m_first_node;       // index in m_nodes
+        uint32_t        m_num_nodes;
+        uint64_t        m_value;
+        uint64_t        m_mask;
+    };
+
+    void add_term(ConditionType type, const node_t *nodes, size_t num_nodes, uint64_t value, uint64_t mask);
+
+private:
+    std::vector<Term>   m_terms;
+    node_container_t    m_nodes;            // the nodes of all the terms
+
+    friend class ConditionMonitor;
+};
+
+// keeps track of the state of the terms of a condition while the simulator runs, only the terms with a node
+//  that changed value are evaluated again
+class ConditionMonitor {
+public:
+    ConditionMonitor(const Simulator *sim, const RunCondition &condition);
+
+    // evaluate the terms that depend on the changed nodes, returns true when one of them was met
+    bool check(const node_container_t &changed);
+
+    // the first term that was met by the last call to check (or TERM_NONE)
+    size_t met_term() const {return m_met_term;}
+
+private:
+    uint64_t evaluate(size_t term) const;
+    bool update(size_t term);
+
+private:
+    const Simulator *           m_sim;
+    const RunCondition &        m_condition;
+    std::vector<uint8_t>        m_node_watched;     // node is used by at least one term
+    std::vector<std::pair<node_t, uint32_t>> m_node_terms;  // (node, term), sorted by node
+    std::vector<uint64_t>       m_state;            // last evaluation of each term
+    std::vector<uint64_t>       m_checked;          // check() that last evaluated the term
+    uint64_t                    m_num_checks = 0;
+    size_t                      m_met_term = TERM_NONE;
+};
+
+} // namespace lsim
+
+#endif // LSIM_SIM_CONDITION_H
@@ -22,6 +22,9 @@ constexpr SimFuncType SIM_FUNCTION_INDEPENDENT = 2;
 using simulation_func_t = std::function<void (Simulator *, SimComponent *comp)>;
 using sim_component_functions_t = std::array<simulation_func_t, 3>;
 
+// batched input changed function: evaluates all dirty components of one type in a single call
+using simulation_batch_func_t = void (*)(Simulator *, const uint32_t *comp_ids, size_t count);
+
 #define SIM_SETUP_FUNC_BEGIN(type)                          \
     sim->register_sim_function(COMPONENT_##type,            \
         SIM_FUNCTION_SETUP,                                 \
@@ -37,6 +40,10 @@ using sim_component_functions_t = std::array<simulation_func_t, 3>;
         SIM_FUNCTION_INDEPENDENT,                           \
         [](Simulator *sim, SimComponent *comp) {
 
+#define SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(type)            \
+    sim->register_batch_function(COMPONENT_##type,          \
+        [](Simulator *sim, const uint32_t *comp_ids, size_t count) {
+
 #define SIM_FUNC_END   }); 
 
 void sim_register_component_functions(Simulator *sim);
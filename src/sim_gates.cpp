@@ -5,92 +5,97 @@
 #include "sim_functions.h"
 #include "simulator.h"
 
+namespace {
+
+using namespace lsim;
+
+// the gates evaluate a complete batch of components straight from the flat pin arrays
+//  - a Value has the boolean state in bit 0, bit 1 is set for an undefined or error value
+//  - any invalid input turns the output of the gate into VALUE_ERROR
+template <typename Reduce>
+inline void gate_kernel(Simulator *sim, const uint32_t *comp_ids, size_t count, uint32_t negate, Reduce reduce) {
+    for (size_t idx = 0; idx < count; ++idx) {
+        auto pins = sim->component_pins(comp_ids[idx]);
+        auto output_pin = sim->component_num_pins(comp_ids[idx]) - 1;
+
+        uint32_t value = sim->read_pin(pins[0]);
+        uint32_t flags = value;
+        for (auto pin = 1u; pin < output_pin; ++pin) {
+            uint32_t input = sim->read_pin(pins[pin]);
+            value = reduce(value, input);
+            flags |= input;
+        }
+
+        auto output = (flags & 2) ? VALUE_ERROR : static_cast<Value>((value & 1) ^ negate);
+        sim->write_pin(pins[output_pin], output);
+    }
+}
+
+inline void buffer_write(Simulator *sim, pin_t pin, Value value) {
+    // don't mark the node as dirty when the buffer keeps not driving it
+    if (value == VALUE_UNDEFINED && sim->pin_stays_undefined(pin)) {
+        return;
+    }
+    sim->write_pin(pin, value);
+}
+
+} // unnamed namespace
+
 namespace lsim {
 
 void sim_register_gate_functions(Simulator *sim) {
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(BUFFER) {
-        for (auto pin = 0u; pin < comp->num_inputs(); ++pin) {
-            auto value = comp->read_pin(comp->input_pin_index(pin));
-            comp->write_pin(comp->output_pin_index(pin), value);
-        }
-    } SIM_FUNC_END
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(BUFFER) {
+        for (size_t idx = 0; idx < count; ++idx) {
+            auto pins = sim->component_pins(comp_ids[idx]);
+            auto num_inputs = sim->component_num_pins(comp_ids[idx]) / 2;
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(TRISTATE_BUFFER) {
-         if (comp->read_pin(comp->control_pin_index(0)) != VALUE_TRUE) {
-            for (auto pin = 0u; pin < comp->num_outputs(); ++pin) {
-                comp->write_pin(comp->output_pin_index(pin), VALUE_UNDEFINED);
-            }
-        } else {
-            for (auto pin = 0u; pin < comp->num_inputs(); ++pin) {
-                auto value = comp->read_pin(comp->input_pin_index(pin));
-                comp->write_pin(comp->output_pin_index(pin), value);
+            for (auto pin = 0u; pin < num_inputs; ++pin) {
+                buffer_write(sim, pins[num_inputs + pin], sim->read_pin(pins[pin]));
             }
         }
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(AND_GATE) {
-        comp->reset_bad_read_check();
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(TRISTATE_BUFFER) {
+        for (size_t idx = 0; idx < count; ++idx) {
+            auto pins = sim->component_pins(comp_ids[idx]);
+            auto num_inputs = (sim->component_num_pins(comp_ids[idx]) - 1) / 2;
+            bool enabled = sim->read_pin(pins[2 * num_inputs]) == VALUE_TRUE;
 
-        bool output = comp->read_pin_checked(0);
-        for (auto idx = 1u; idx < comp->num_inputs(); ++idx) {
-            output &= comp->read_pin_checked(idx);
+            for (auto pin = 0u; pin < num_inputs; ++pin) {
+                buffer_write(sim, pins[num_inputs + pin], enabled ? sim->read_pin(pins[pin]) : VALUE_UNDEFINED);
+            }
         }
-        comp->write_pin_checked(comp->output_pin_index(0), output);
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(OR_GATE) {
-        comp->reset_bad_read_check();
-
-        bool output = comp->read_pin_checked(0);
-        for (auto idx = 1u; idx < comp->num_inputs(); ++idx) {
-            output |= comp->read_pin_checked(idx);
-        }
-        comp->write_pin_checked(comp->output_pin_index(0), output);
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(AND_GATE) {
+        gate_kernel(sim, comp_ids, count, 0, [](uint32_t a, uint32_t b) {return a & b;});
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(NOT_GATE) {
-        comp->reset_bad_read_check();
-        auto input = comp->read_pin_checked(0);
-        comp->write_pin_checked(1, !input);
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(OR_GATE) {
+        gate_kernel(sim, comp_ids, count, 0, [](uint32_t a, uint32_t b) {return a | b;});
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(NAND_GATE) {
-        comp->reset_bad_read_check();
-
-        bool output = comp->read_pin_checked(0);
-        for (auto idx = 1u; idx < comp->num_inputs(); ++idx) {
-            output &= comp->read_pin_checked(idx);
-        }
-        comp->write_pin_checked(comp->output_pin_index(0), !output);
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(NOT_GATE) {
+        gate_kernel(sim, comp_ids, count, 1, [](uint32_t a, uint32_t) {return a;});
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(NOR_GATE) {
-        comp->reset_bad_read_check();
-
-        bool output = comp->read_pin_checked(0);
-        for (auto idx = 1u; idx < comp->num_inputs(); ++idx) {
-            output |= comp->read_pin_checked(idx);
-        }
-        comp->write_pin_checked(comp->output_pin_index(0), !output);
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(NAND_GATE) {
+        gate_kernel(sim, comp_ids, count, 1, [](uint32_t a, uint32_t b) {return a & b;});
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(XOR_GATE) {
-        comp->reset_bad_read_check();
-
-        auto output = comp->read_pin_checked(0);
-        output ^= static_cast<int>(comp->read_pin_checked(1));
-        comp->write_pin_checked(2, output);
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(NOR_GATE) {
+        gate_kernel(sim, comp_ids, count, 1, [](uint32_t a, uint32_t b) {return a | b;});
     } SIM_FUNC_END
 
-    SIM_INPUT_CHANGED_FUNC_BEGIN(XNOR_GATE) {
-        comp->reset_bad_read_check();
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(XOR_GATE) {
+        gate_kernel(sim, comp_ids, count, 0, [](uint32_t a, uint32_t b) {return a ^ b;});
+    } SIM_FUNC_END
 
-        auto output = comp->read_pin_checked(0);
-        output ^= static_cast<int>(comp->read_pin_checked(1));
-        comp->write_pin_checked(2, !output);
+    SIM_INPUT_CHANGED_BATCH_FUNC_BEGIN(XNOR_GATE) {
+        gate_kernel(sim, comp_ids, count, 1, [](uint32_t a, uint32_t b) {return a ^ b;});
     } SIM_FUNC_END
 }
 
 
-} // namespace lsim
\ No newline at end of file
+} // namespace lsim
@@ -0,0 +1,162 @@
+// sim_timing_wheel.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// event queue for events that are scheduled at an absolute simulation timestamp
+
+#ifndef LSIM_SIM_TIMING_WHEEL_H
+#define LSIM_SIM_TIMING_WHEEL_H
+
+#include "sim_types.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace lsim {
+
+// a timing wheel is a circular array of buckets, one per timestamp. Events that are scheduled further
+//  in the future than the wheel can hold are kept in an overflow list and moved into the wheel when
+//  the current time catches up with them. Scheduling and retrieving an event is O(1) in the common case.
+template <typename Event>
+class TimingWheel {
+public:
+    explicit TimingWheel(size_t num_slots = 256);
+
+    void clear(timestamp_t now);
+    bool empty() const {return m_num_events == 0 && m_overflow.empty();}
+
+    // schedule an event, 'when' must be later than the time of the last call to clear/pop_due
+    void schedule(timestamp_t when, const Event &event);
+
+    // timestamp of the earliest scheduled event (TIMESTAMP_NEVER when there are none)
+    timestamp_t next_time() const;
+
+    // advance the wheel to 'now' and call the handler (in time order) for every event that is due
+    template <typename Handler>
+    void pop_due(timestamp_t now, Handler handler);
+
+private:
+    struct Entry {
+        timestamp_t m_time;
+        Event       m_event;
+    };
+    using bucket_t = std::vector<Entry>;
+
+    bucket_t &slot(timestamp_t when) {return m_slots[when & m_mask];}
+    void refill_from_overflow();
+
+private:
+    std::vector<bucket_t>   m_slots;
+    timestamp_t             m_mask;
+    timestamp_t             m_now = 0;
+    size_t                  m_num_events = 0;           // number of events in the wheel (excluding overflow)
+    bucket_t                m_overflow;                 // events beyond the horizon of the wheel
+    timestamp_t             m_overflow_min = TIMESTAMP_NEVER;
+    bucket_t                m_processing;               // bucket that is being processed by pop_due
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// implementation
+//
+
+template <typename Event>
+TimingWheel<Event>::TimingWheel(size_t num_slots) :
+        m_slots(num_slots),
+        m_mask(num_slots - 1) {
+    assert(num_slots >= 2 && (num_slots & (num_slots - 1)) == 0);
+}
+
+template <typename Event>
+void TimingWheel<Event>::clear(timestamp_t now) {
+    for (auto &bucket : m_slots) {
+        bucket.clear();
+    }
+    m_overflow.clear();
+    m_overflow_min = TIMESTAMP_NEVER;
+    m_num_events = 0;
+    m_now = now;
+}
+
+template <typename Event>
+void TimingWheel<Event>::schedule(timestamp_t when, const Event &event) {
+    assert(when > m_now);
+
+    if (when - m_now < m_slots.size()) {
+        slot(when).push_back({when, event});
+        m_num_events += 1;
+    } else {
+        m_overflow.push_back({when, event});
+        m_overflow_min = std::min(m_overflow_min, when);
+    }
+}
+
+template <typename Event>
+timestamp_t TimingWheel<Event>::next_time() const {
+    if (m_num_events > 0) {
+        for (timestamp_t t = m_now + 1; t < m_now + m_slots.size(); ++t) {
+            if (!m_slots[t & m_mask].empty()) {
+                return t;
+            }
+        }
+    }
+
+    return m_overflow_min;
+}
+
+template <typename Event>
+template <typename Handler>
+void TimingWheel<Event>::pop_due(timestamp_t now, Handler handler) {
+    while (m_now < now) {
+        // nothing in the wheel: jump straight to the earliest overflow event (or to 'now')
+        if (m_num_events == 0) {
+            m_now = (m_overflow_min == TIMESTAMP_NEVER) ? now : std::min(now, m_overflow_min - 1);
+            refill_from_overflow();
+            continue;
+        }
+
+        m_now += 1;
+        auto &bucket = slot(m_now);
+        if (!bucket.empty()) {
+            // the handler is allowed to schedule new events: don't process the bucket in place
+            m_processing.clear();
+            std::swap(m_processing, bucket);
+            m_num_events -= m_processing.size();
+            for (const auto &entry : m_processing) {
+                assert(entry.m_time == m_now);
+                handler(entry.m_event);
+            }
+        }
+
+        if (m_overflow_min < m_now + m_slots.size()) {
+            refill_from_overflow();
+        }
+    }
+}
+
+template <typename Event>
+void TimingWheel<Event>::refill_from_overflow() {
+    auto horizon = m_now + m_slots.size();
+    if (m_overflow_min >= horizon) {
+        return;
+    }
+
+    m_overflow_min = TIMESTAMP_NEVER;
+    size_t keep = 0;
+
+    for (const auto &entry : m_overflow) {
+        if (entry.m_time < horizon) {
+            assert(entry.m_time > m_now);
+            slot(entry.m_time).push_back(entry);
+            m_num_events += 1;
+        } else {
+            m_overflow_min = std::min(m_overflow_min, entry.m_time);
+            m_overflow[keep++] = entry;
+        }
+    }
+
+    m_overflow.resize(keep);
+}
+
+} // namespace lsim
+
+#endif // LSIM_SIM_TIMING_WHEEL_H
@@ -5,10 +5,15 @@
 #ifndef LSIM_SIM_TYPES_H
 #define LSIM_SIM_TYPES_H
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <vector>
 
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
 namespace lsim {
 
 using node_t = uint32_t;
@@ -26,8 +31,122 @@ using node_container_t = std::vector<node_t>;
 using pin_container_t = std::vector<pin_t>;
 using value_container_t = std::vector<Value>;
 
+// compressed sparse row storage: a list of variable length rows packed in one contiguous array.
+//  the elements of row 'i' are stored in m_data[m_offsets[i]] up to (not including) m_data[m_offsets[i+1]]
+template <typename T>
+struct CsrArray {
+    std::vector<uint32_t>   m_offsets = {0};
+    std::vector<T>          m_data;
+
+    size_t num_rows() const {return m_offsets.size() - 1;}
+    size_t row_size(size_t row) const {return m_offsets[row+1] - m_offsets[row];}
+    const T *row_begin(size_t row) const {return m_data.data() + m_offsets[row];}
+    const T *row_end(size_t row) const {return m_data.data() + m_offsets[row+1];}
+    T *row_begin(size_t row) {return m_data.data() + m_offsets[row];}
+
+    void clear() {
+        m_offsets.assign(1, 0);
+        m_data.clear();
+    }
+
+    template <typename Iter>
+    void append_row(Iter first, Iter last) {
+        m_data.insert(m_data.end(), first, last);
+        m_offsets.push_back(static_cast<uint32_t>(m_data.size()));
+    }
+
+    // replace the contents with rows of the given sizes, the elements are default initialized
+    void assign_row_sizes(const std::vector<uint32_t> &sizes) {
+        m_offsets.resize(sizes.size() + 1);
+        m_offsets[0] = 0;
+        for (size_t row = 0; row < sizes.size(); ++row) {
+            m_offsets[row + 1] = m_offsets[row] + sizes[row];
+        }
+        m_data.assign(m_offsets.back(), T());
+    }
+
+    // append a row of 'size' default initialized elements, returns the start of the new row
+    T *append_row(size_t size) {
+        m_data.resize(m_data.size() + size);
+        m_offsets.push_back(static_cast<uint32_t>(m_data.size()));
+        return m_data.data() + m_data.size() - size;
+    }
+};
+
+// index of the lowest set bit (value must not be zero)
+inline unsigned count_trailing_zeros(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+// Values packed in two bit-planes, 64 values per pair of words. Like the Value enum, plane 0 holds the boolean
+//  state and plane 1 is set for undefined (0) or error (1) values. Two containers can be compared a word at a time.
+class PackedValues {
+public:
+    struct Word {
+        uint64_t    m_bit0;
+        uint64_t    m_bit1;
+    };
+
+public:
+    size_t size() const {return m_size;}
+    void clear() {m_words.clear(); m_size = 0;}
+
+    void push_back(Value value) {
+        if ((m_size & 63) == 0) {
+            m_words.push_back({0, 0});
+        }
+        set(m_size++, value);
+    }
+
+    void assign(size_t size, Value value) {
+        m_words.resize((size + 63) / 64);
+        m_size = size;
+        fill(value);
+    }
+
+    void fill(Value value) {
+        Word word = {(value & 1) ? ~0ull : 0ull, (value & 2) ? ~0ull : 0ull};
+        std::fill(std::begin(m_words), std::end(m_words), word);
+    }
+
+    Value operator[](size_t idx) const {
+        const auto &word = m_words[idx >> 6];
+        auto shift = idx & 63;
+        return static_cast<Value>(((word.m_bit0 >> shift) & 1) | (((word.m_bit1 >> shift) & 1) << 1));
+    }
+
+    void set(size_t idx, Value value) {
+        auto &word = m_words[idx >> 6];
+        auto mask = 1ull << (idx & 63);
+        word.m_bit0 = (word.m_bit0 & ~mask) | ((value & 1) ? mask : 0);
+        word.m_bit1 = (word.m_bit1 & ~mask) | ((value & 2) ? mask : 0);
+    }
+
+    // raw access to the bit-planes: value N is stored in bit (N % 64) of word (N / 64)
+    size_t num_words() const {return m_words.size();}
+    Word *words() {return m_words.data();}
+    const Word *words() const {return m_words.data();}
+
+    // the bits of the last word that are in use
+    uint64_t last_word_mask() const {return (m_size & 63) ? (1ull << (m_size & 63)) - 1 : ~0ull;}
+
+private:
+    std::vector<Word>   m_words;
+    size_t              m_size = 0;
+};
+
 const pin_t PIN_UNDEFINED = static_cast<pin_t>(-1);
 const node_t NODE_INVALID = static_cast<node_t>(-1);
+const timestamp_t TIMESTAMP_NEVER = static_cast<timestamp_t>(-1);
+
+// step budget without a limit (e.g. of run_until_stable)
+const size_t STEPS_UNLIMITED = static_cast<size_t>(-1);
 
 // pin-ids are used in the circuit description
 using pin_id_t = uint64_t;
@@ -52,6 +171,7 @@ const ComponentType COMPONENT_VIA = 0x0020;
 const ComponentType COMPONENT_OSCILLATOR = 0x0021;
 const ComponentType COMPONENT_7_SEGMENT_LED = 0x0101;
 const ComponentType COMPONENT_SUB_CIRCUIT = 0x0301;
+const ComponentType COMPONENT_LOOKUP_TABLE = 0x0302;      // a sub-circuit simulated by its truth table
 const ComponentType COMPONENT_TEXT = 0x0401;
 const ComponentType COMPONENT_MAX_TYPE_ID = COMPONENT_TEXT;
 
@@ -62,10 +182,23 @@ struct ExtraDataOscillator {
 };
 
 struct ExtraData7SegmentLED {
+    timestamp_t m_last_sample;
     size_t   m_num_samples;
     uint32_t m_samples[8];
 };
 
+struct ExtraDataLookupTable {
+    uint32_t m_table;               // index of the lookup table in the simulator
+};
+
+// truth table of a combinational circuit: entry 'i' holds the outputs for the inputs with the bits of 'i' as values
+struct LookupTable {
+    uint32_t            m_num_inputs;
+    uint32_t            m_num_outputs;
+    value_container_t   m_values;   // entry * m_num_outputs + output
+    std::vector<uint32_t> m_dependencies;   // output => mask of the inputs that can change the value of the output
+};
+
 // forward declarations
 class ModelComponent;
 class ModelCircuit;
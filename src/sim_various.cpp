@@ -6,6 +6,8 @@
 #include "simulator.h"
 #include "model_circuit.h"
 
+#include <algorithm>
+
 namespace lsim {
 
 void sim_register_various_functions(Simulator *sim) {
@@ -54,9 +56,13 @@ void sim_register_various_functions(Simulator *sim) {
 
         auto value = sim->pin_output_value(comp->pin_by_index(0));
 
-        extra->m_duration[0] = comp->description()->property_value("low_duration", static_cast<int64_t>(1));
-        extra->m_duration[1] = comp->description()->property_value("high_duration", static_cast<int64_t>(1));
+        extra->m_duration[0] = std::max<int64_t>(1, comp->description()->property_value("low_duration", static_cast<int64_t>(1)));
+        extra->m_duration[1] = std::max<int64_t>(1, comp->description()->property_value("high_duration", static_cast<int64_t>(1)));
         extra->m_next_change = sim->current_time() + extra->m_duration[value];
+
+        // the oscillator only has to run when its output changes
+        sim->deactivate_independent_simulation_func(comp);
+        sim->schedule_independent_simulation_func(comp, extra->m_next_change);
     } SIM_FUNC_END;
 
     SIM_INDEPENDENT_FUNC_BEGIN(OSCILLATOR) {
@@ -68,22 +74,52 @@ void sim_register_various_functions(Simulator *sim) {
             extra->m_next_change = sim->current_time() + extra->m_duration[new_value];
             comp->write_pin(comp->output_pin_index(0), new_value);
         }
+        sim->schedule_independent_simulation_func(comp, extra->m_next_change);
+    } SIM_FUNC_END;
+
+    SIM_INPUT_CHANGED_FUNC_BEGIN(LOOKUP_TABLE) {
+        auto *extra = reinterpret_cast<ExtraDataLookupTable *>(comp->extra_data());
+        const auto &table = sim->lookup_table(extra->m_table);
+
+        // the inputs select an entry of the table. An input without a boolean value is read as false: only the
+        //  outputs that depend on it are an error, the others have the same value for either boolean value.
+        uint32_t entry = 0;
+        uint32_t invalid = 0;
+        for (auto idx = 0u; idx < table.m_num_inputs; ++idx) {
+            auto value = comp->read_pin(comp->input_pin_index(idx));
+            invalid |= static_cast<uint32_t>(value != VALUE_FALSE && value != VALUE_TRUE) << idx;
+            entry |= (value & 1) << idx;
+        }
+        entry &= ~invalid;
+
+        const auto *outputs = table.m_values.data() + entry * table.m_num_outputs;
+        for (auto idx = 0u; idx < table.m_num_outputs; ++idx) {
+            auto valid = (table.m_dependencies[idx] & invalid) == 0;
+            comp->write_pin(comp->output_pin_index(idx), valid ? outputs[idx] : VALUE_ERROR);
+        }
     } SIM_FUNC_END;
 
     SIM_SETUP_FUNC_BEGIN(7_SEGMENT_LED) {
         comp->set_extra_data_size(sizeof(ExtraData7SegmentLED));
+        auto *extra = reinterpret_cast<ExtraData7SegmentLED *>(comp->extra_data());
+        *extra = {};
+        extra->m_last_sample = sim->current_time();
     } SIM_FUNC_END;
 
     SIM_INDEPENDENT_FUNC_BEGIN(7_SEGMENT_LED) {
         auto *extra = reinterpret_cast<ExtraData7SegmentLED *>(comp->extra_data());
         auto led_on = comp->read_pin(comp->control_pin_index(0));
 
+        // inputs didn't change during steps skipped by run_until: weigh the sample by the elapsed time
+        auto elapsed = static_cast<uint32_t>(sim->current_time() - extra->m_last_sample);
+        extra->m_last_sample = sim->current_time();
+
         if (led_on == VALUE_TRUE) {
             for (auto pin_idx = 0u; pin_idx < comp->num_inputs(); ++pin_idx) {
-                extra->m_samples[pin_idx] += comp->read_pin(comp->input_pin_index(pin_idx)) == VALUE_TRUE ? 1: 0;
+                extra->m_samples[pin_idx] += comp->read_pin(comp->input_pin_index(pin_idx)) == VALUE_TRUE ? elapsed : 0;
             }
         }
-        extra->m_num_samples += 1;
+        extra->m_num_samples += elapsed;
     } SIM_FUNC_END;
 }
 
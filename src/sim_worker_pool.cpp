@@ -0,0 +1,183 @@
+// sim_worker_pool.cpp - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// a small pool of persistent threads to spread the work of a simulation step over multiple cores
+
+#include "sim_worker_pool.h"
+
+#include <cassert>
+#include <chrono>
+
+namespace {
+
+inline uint64_t pack_range(uint64_t front, uint64_t back) {
+    return front | (back << 32);
+}
+
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // unnamed namespace
+
+namespace lsim {
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(size_t num_threads) {
+    stop();
+
+    m_quit = false;
+    m_queues = std::make_unique<TaskQueue[]>(num_threads);
+    for (size_t worker = 1; worker < num_threads; ++worker) {
+        m_threads.emplace_back([this, worker, generation = m_generation]() {worker_main(worker, generation);});
+    }
+}
+
+void WorkerPool::stop() {
+    if (m_threads.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_start_cv.notify_all();
+
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+WorkerPoolStats WorkerPool::run(size_t num_tasks, const task_func_t &task) {
+    assert(num_tasks < (1ull << 32));
+
+    WorkerPoolStats stats;
+    stats.m_num_tasks = num_tasks;
+    auto start = std::chrono::steady_clock::now();
+
+    if (m_threads.empty()) {
+        for (size_t idx = 0; idx < num_tasks; ++idx) {
+            task(idx);
+        }
+        stats.m_wall_time = stats.m_busy_time = seconds_since(start);
+        stats.m_efficiency = 1.0;
+        return stats;
+    }
+
+    // divide the tasks evenly over the workers
+    auto workers = num_threads();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t worker = 0; worker < workers; ++worker) {
+            m_queues[worker].m_range = pack_range(worker * num_tasks / workers, (worker + 1) * num_tasks / workers);
+            m_queues[worker].m_stolen = 0;
+            m_queues[worker].m_busy_time = 0;
+        }
+        m_task = &task;
+        m_busy = m_threads.size();
+        m_generation += 1;
+    }
+    m_start_cv.notify_all();
+
+    // the calling thread is worker 0
+    execute_tasks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this]() {return m_busy == 0;});
+    m_task = nullptr;
+
+    stats.m_wall_time = seconds_since(start);
+    for (size_t worker = 0; worker < workers; ++worker) {
+        stats.m_num_stolen += m_queues[worker].m_stolen;
+        stats.m_busy_time += m_queues[worker].m_busy_time;
+    }
+    if (stats.m_wall_time > 0) {
+        stats.m_efficiency = stats.m_busy_time / (stats.m_wall_time * workers);
+    }
+
+    return stats;
+}
+
+void WorkerPool::worker_main(size_t worker, uint64_t generation) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cv.wait(lock, [&]() {return m_quit || m_generation != generation;});
+            if (m_quit) {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        execute_tasks(worker);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy == 0) {
+            m_done_cv.notify_one();
+        }
+    }
+}
+
+void WorkerPool::execute_tasks(size_t worker) {
+    assert(m_task);
+
+    auto &queue = m_queues[worker];
+    auto workers = num_threads();
+    size_t task = 0;
+
+    while (true) {
+        bool found = pop_task(worker, task);
+        for (size_t offset = 1; !found && offset < workers; ++offset) {
+            found = steal_task((worker + offset) % workers, task);
+            queue.m_stolen += found ? 1 : 0;
+        }
+        if (!found) {
+            // no tasks left anywhere (they are never added during a run)
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        (*m_task)(task);
+        queue.m_busy_time += seconds_since(start);
+    }
+}
+
+bool WorkerPool::pop_task(size_t worker, size_t &task) {
+    auto &range = m_queues[worker].m_range;
+    auto current = range.load();
+
+    while (true) {
+        auto front = current & 0xffffffff;
+        auto back = current >> 32;
+        if (front >= back) {
+            return false;
+        }
+        if (range.compare_exchange_weak(current, pack_range(front + 1, back))) {
+            task = front;
+            return true;
+        }
+    }
+}
+
+bool WorkerPool::steal_task(size_t victim, size_t &task) {
+    auto &range = m_queues[victim].m_range;
+    auto current = range.load();
+
+    while (true) {
+        auto front = current & 0xffffffff;
+        auto back = current >> 32;
+        if (front >= back) {
+            return false;
+        }
+        if (range.compare_exchange_weak(current, pack_range(front, back - 1))) {
+            task = back - 1;
+            return true;
+        }
+    }
+}
+
+} // namespace lsim
@@ -0,0 +1,75 @@
+// sim_worker_pool.h - Johan Smet - BSD-3-Clause (see LICENSE)
+//
+// a small pool of persistent threads to spread the work of a simulation step over multiple cores
+
+#ifndef LSIM_SIM_WORKER_POOL_H
+#define LSIM_SIM_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lsim {
+
+// measurements of a single call to WorkerPool::run
+struct WorkerPoolStats {
+    size_t  m_num_tasks = 0;
+    size_t  m_num_stolen = 0;       // tasks that were executed by another worker than the one they were assigned to
+    double  m_wall_time = 0;        // seconds between the start and the end of the run
+    double  m_busy_time = 0;        // seconds spent executing tasks, summed over all workers
+    double  m_efficiency = 0;       // busy time / (wall time * number of threads)
+};
+
+// the tasks are divided evenly over the workers up front. A worker that runs out of work steals tasks
+//  from the back of the queue of another worker, so a few expensive tasks don't leave the other cores idle.
+class WorkerPool {
+public:
+    using task_func_t = std::function<void(size_t task)>;
+public:
+    WorkerPool() = default;
+    WorkerPool(const WorkerPool &) = delete;
+    ~WorkerPool();
+
+    // num_threads includes the thread that calls run()
+    void start(size_t num_threads);
+    void stop();
+    size_t num_threads() const {return m_threads.size() + 1;}
+
+    // execute task(0) ... task(num_tasks - 1) and wait until all of them are finished
+    WorkerPoolStats run(size_t num_tasks, const task_func_t &task);
+
+private:
+    // tasks [front, back) of a worker, packed in one word so the owner and the thieves can update it atomically
+    struct alignas(64) TaskQueue {
+        std::atomic<uint64_t>   m_range{0};
+        size_t                  m_stolen = 0;
+        double                  m_busy_time = 0;
+    };
+
+    void worker_main(size_t worker, uint64_t generation);
+    void execute_tasks(size_t worker);
+    bool pop_task(size_t worker, size_t &task);
+    bool steal_task(size_t victim, size_t &task);
+
+private:
+    std::vector<std::thread>        m_threads;
+    std::unique_ptr<TaskQueue[]>    m_queues;
+    std::mutex                      m_mutex;
+    std::condition_variable         m_start_cv;
+    std::condition_variable         m_done_cv;
+    uint64_t                        m_generation = 0;       // incremented for each call to run()
+    size_t                          m_busy = 0;             // number of workers that haven't finished the current run
+    bool                            m_quit = false;
+
+    const task_func_t *             m_task = nullptr;
+};
+
+} // namespace lsim
+
+#endif // LSIM_SIM_WORKER_POOL_H
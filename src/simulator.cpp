@@ -4,18 +4,92 @@
 #include "sim_functions.h"
 #include "model_circuit.h"
 #include "sim_circuit.h"
+#include "error.h"
 
 #include <cassert>
+#include <numeric>
 #include "std_helper.h"
 
+namespace {
+
+using namespace lsim;
+
+// components that only compute their outputs from their inputs (the netlist optimizations may skip them)
+inline bool is_removable(ComponentType type) {
+    return type >= COMPONENT_BUFFER && type <= COMPONENT_XNOR_GATE;
+}
+
+// components with outputs that can be computed at build time when all their inputs are constant
+inline bool is_foldable(ComponentType type) {
+    return is_removable(type) && type != COMPONENT_TRISTATE_BUFFER;
+}
+
+// output of a gate with the given input values (as computed by gate_kernel in sim_gates.cpp)
+Value fold_gate(ComponentType type, const Value *inputs, size_t count) {
+    uint32_t value = inputs[0];
+    uint32_t flags = inputs[0];
+    for (size_t idx = 1; idx < count; ++idx) {
+        switch (type) {
+            case COMPONENT_AND_GATE :
+            case COMPONENT_NAND_GATE :
+                value &= inputs[idx];
+                break;
+            case COMPONENT_OR_GATE :
+            case COMPONENT_NOR_GATE :
+                value |= inputs[idx];
+                break;
+            default :
+                value ^= inputs[idx];
+                break;
+        }
+        flags |= inputs[idx];
+    }
+
+    uint32_t negate = type == COMPONENT_NOT_GATE || type == COMPONENT_NAND_GATE ||
+                      type == COMPONENT_NOR_GATE || type == COMPONENT_XNOR_GATE;
+    return (flags & 2) ? VALUE_ERROR : static_cast<Value>((value & 1) ^ negate);
+}
+
+// components whose output pins write to their nodes: constants and pull resistors only set the initial/default
+//  value, the ports of a sub-circuit and the input connectors of a nested circuit (without user values) are only
+//  connected to the pins inside/outside the circuit
+inline bool can_drive(const SimComponent &comp) {
+    auto type = comp.description()->type();
+    return type != COMPONENT_CONSTANT && type != COMPONENT_PULL_RESISTOR && type != COMPONENT_SUB_CIRCUIT &&
+           (type != COMPONENT_CONNECTOR_IN || comp.user_values_enabled());
+}
+
+// key of a gate for structural hashing
+struct GateKeyHash {
+    size_t operator()(const std::vector<uint32_t> &key) const {
+        size_t result = key.size();
+        for (auto value : key) {
+            result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2);
+        }
+        return result;
+    }
+};
+
+} // unnamed namespace
+
 namespace lsim {
 
 SimComponent *Simulator::create_component(ModelComponent *desc) {
-    auto sim_comp = std::make_unique<SimComponent>(this, desc, static_cast<uint32_t> (m_components.size()));
-    auto result = sim_comp.get();
+    assert(!m_is_fork);
+    m_components.emplace_back(this, desc, static_cast<uint32_t> (m_components.size()));
+    auto result = &m_components.back();
+
+    // the pins of the component are stored consecutively in the pin arena
+    auto num_inputs = desc->num_inputs();
+    auto num_pins = num_inputs + desc->num_outputs() + desc->num_controls();
+    auto pins = m_component_pins.append_row(num_pins);
+    for (size_t idx = 0; idx < num_pins; ++idx) {
+        pins[idx] = assign_pin();
+    }
 
-    m_components.push_back(std::move(sim_comp));
-	m_input_changed.push_back(0);
+	m_input_changed.push_back(EPOCH_NONE);
+    m_scheduled_time.push_back(0);
+    m_topology_dirty = true;
 
     if (component_has_function(desc->type(), SIM_FUNCTION_SETUP)) {
         m_init_components.push_back(result);       
@@ -28,42 +102,125 @@ SimComponent *Simulator::create_component(ModelComponent *desc) {
     return result;
 }
 
+SimComponent *Simulator::component_by_id(uint32_t comp_id) {
+    assert(comp_id < m_components.size());
+    return &m_components[comp_id];
+}
+
 void Simulator::clear_components() {
     m_components.clear();
+    m_component_pins.clear();
+    m_user_values.clear();
+    m_extra_data.clear();
+    m_lookup_tables.clear();
     m_init_components.clear();
     m_independent_components.clear();
+    m_clocks.clear();
+    m_input_changed.clear();
+    m_scheduled_time.clear();
+    m_scheduled_components.clear(m_time);
+    m_component_timing.clear();
+    m_timed_pins.clear();
+    m_pin_timed.clear();
+    m_delayed_writes.clear(m_time);
+    m_delays_active = false;
+    m_dirty_components.clear();
     clear_pins();
     clear_nodes();
+    clear_watchpoints();
+    m_pin_deferred.clear();
+    m_deferred_values.clear();
+    m_levelized = false;
+    m_levels_valid = false;
+    m_component_level.clear();
+    m_level_batches.clear();
+    m_topology_dirty = false;
+}
+
+uint32_t Simulator::allocate_user_values(size_t count) {
+    auto result = static_cast<uint32_t>(m_user_values.size());
+    m_user_values.resize(m_user_values.size() + count, VALUE_UNDEFINED);
+    return result;
+}
+
+uint32_t Simulator::allocate_extra_data(size_t size) {
+    // bump allocator: keep every allocation aligned for the widest scalar type
+    const size_t align = alignof(std::max_align_t);
+    auto result = (m_extra_data.size() + align - 1) & ~(align - 1);
+    m_extra_data.resize(result + size);
+    return static_cast<uint32_t>(result);
 }
 
-pin_t Simulator::assign_pin(SimComponent *component, bool used_as_input) {
-    auto result = static_cast<pin_t>(m_pin_nodes.size());
-	auto node_id = assign_node(component, used_as_input);
-	m_pin_nodes.push_back(node_id);
+uint32_t Simulator::add_lookup_table(std::shared_ptr<const LookupTable> table) {
+    assert(table);
+    auto result = static_cast<uint32_t>(m_lookup_tables.size());
+    m_lookup_tables.push_back(std::move(table));
+    return result;
+}
+
+pin_t Simulator::assign_pin() {
+    auto result = static_cast<pin_t>(m_pin_parent.size());
+    m_pin_parent.push_back(result);
+    m_pin_rank.push_back(0);
+    m_pin_nodes.push_back(NODE_INVALID);
+    m_pin_observed.push_back(false);
     m_pin_values.push_back(VALUE_UNDEFINED);
-	m_node_metadata[node_id].m_pins.push_back(result);
+    m_pin_active.push_back(false);
+    m_topology_dirty = true;
     return result;
 }
 
-node_t Simulator::connect_pins(pin_t pin_a, pin_t pin_b) {
+void Simulator::connect_pins(pin_t pin_a, pin_t pin_b) {
+    assert(!m_is_fork);
     assert(pin_a != pin_b);
-    assert(pin_a < m_pin_nodes.size());
-    assert(pin_b < m_pin_nodes.size());
+    assert(pin_a < m_pin_parent.size());
+    assert(pin_b < m_pin_parent.size());
 
-    const auto node_a = m_pin_nodes[pin_a];
-    const auto node_b = m_pin_nodes[pin_b];
+    auto root_a = pin_root(pin_a);
+    auto root_b = pin_root(pin_b);
 
-    if (node_a == node_b) {
+    if (root_a == root_b) {
         // pins already connected to each other
-        return node_a;
+        return;
     }
 
-    return merge_nodes(node_a, node_b);
+    // union by rank: attach the lower tree to the root of the higher one
+    if (m_pin_rank[root_a] < m_pin_rank[root_b]) {
+        std::swap(root_a, root_b);
+    }
+    m_pin_parent[root_b] = root_a;
+    if (m_pin_rank[root_a] == m_pin_rank[root_b]) {
+        m_pin_rank[root_a] += 1;
+    }
+    m_topology_dirty = true;
+}
+
+pin_t Simulator::pin_root(pin_t pin) {
+    // path halving: every other pin on the path is linked to its grandparent
+    while (m_pin_parent[pin] != pin) {
+        m_pin_parent[pin] = m_pin_parent[m_pin_parent[pin]];
+        pin = m_pin_parent[pin];
+    }
+    return pin;
+}
+
+void Simulator::pin_set_observed(pin_t pin) {
+    assert(!m_is_fork);
+    assert(pin < m_pin_observed.size());
+
+    if (!m_pin_observed[pin]) {
+        m_pin_observed[pin] = true;
+        m_topology_dirty |= m_netlist_optimizations != OPTIMIZE_NONE;
+    }
 }
 
 void Simulator::clear_pins() {
+    m_pin_parent.clear();
+    m_pin_rank.clear();
     m_pin_nodes.clear();
+    m_pin_observed.clear();
     m_pin_values.clear();
+    m_pin_active.clear();
 }
 
 void Simulator::pin_set_default(pin_t pin, Value value) {
@@ -77,25 +234,10 @@ void Simulator::pin_set_initial_value(pin_t pin, Value value) {
     assert(pin < m_pin_nodes.size());
 
     auto node_id = m_pin_nodes[pin];
-    m_pin_values[pin] = value;
+    m_pin_values.set(pin, value);
     node_set_initial_value(node_id, value);
 }
 
-void Simulator::write_pin(pin_t pin, Value value) {
-    assert(pin < m_pin_nodes.size());
-
-    auto node_id = m_pin_nodes[pin];
-    m_pin_values[pin] = value;
-    write_node(node_id, value, pin);
-}
-
-Value Simulator::read_pin(pin_t pin) const {
-    assert(pin < m_pin_nodes.size());
-
-    auto node_id = m_pin_nodes[pin];
-    return read_node(node_id);
-}
-
 Value Simulator::read_pin_current_step(pin_t pin) const {
     assert(pin < m_pin_nodes.size());
 
@@ -118,123 +260,39 @@ timestamp_t Simulator::pin_last_change_time(pin_t pin) const {
 }
 
 node_t Simulator::pin_node(pin_t pin) const {
+    assert(!m_topology_dirty);          // nodes are assigned by finalize()
     assert(pin < m_pin_nodes.size());
     return m_pin_nodes[pin];
 }
 
-Value Simulator::pin_output_value(pin_t pin) const {
-    assert(pin < m_pin_nodes.size());
-    return m_pin_values[pin];
-}
-
 void Simulator::pin_set_output_value(pin_t pin, Value value) {
     assert(pin < m_pin_nodes.size());
-    m_pin_values[pin] = value;
-}
-
-node_t Simulator::assign_node(SimComponent *component, bool used_as_input) {
-    if (!m_free_nodes.empty()) {
-        auto id = m_free_nodes.back();
-        m_free_nodes.pop_back();
-        m_node_values_read[id] = VALUE_UNDEFINED;
-        m_node_values_write[id] = VALUE_UNDEFINED;
-        m_node_metadata[id].m_default = VALUE_UNDEFINED;
-		m_node_metadata[id].m_dependents.clear();
-		m_node_metadata[id].m_pins.clear();
-		m_node_metadata[id].m_active_pins.clear();
-		m_node_metadata[id].m_time_dirty_write = 0;
-        m_node_write_time[id] = 0;
-        m_node_change_time[id] = 0;
-        if (used_as_input) {
-            m_node_metadata[id].m_dependents.insert(component);
-        }
-        return id;
-    }
-
-    m_node_values_read.push_back(VALUE_UNDEFINED);
-    m_node_values_write.push_back(VALUE_UNDEFINED);
-    m_node_metadata.push_back(NodeMetadata());
-    m_node_write_time.push_back(0);
-    m_node_change_time.push_back(0);
-    if (used_as_input) {
-        m_node_metadata.back().m_dependents.insert(component);
-    }
-
-    return static_cast<node_t> (m_node_values_read.size()) - 1;
-}
-
-void Simulator::release_node(node_t node_id) {
-    assert(node_id < m_node_values_read.size());
-    m_free_nodes.push_back(node_id);
+    m_pin_values.set(pin, value);
 }
 
 void Simulator::clear_nodes() {
-    m_free_nodes.clear();
     m_node_values_read.clear();
     m_node_values_write.clear();
-    m_node_metadata.clear();
+    m_node_defaults.clear();
+    m_node_active_pins.clear();
+    m_node_time_dirty_write.clear();
     m_dirty_nodes_read.clear();
     m_dirty_nodes_write.clear();
-    m_node_write_time.clear();
+    m_node_change_epoch.clear();
     m_node_change_time.clear();
-}
-
-node_t Simulator::merge_nodes(node_t node_a, node_t node_b) {
-    assert(node_a != node_b);
-    release_node(node_b);
-	
-	auto& meta_a = m_node_metadata[node_a];
-	auto& meta_b = m_node_metadata[node_b];
-	
-	meta_a.m_pins.reserve(meta_a.m_pins.size() + meta_b.m_pins.size());
-	for (const auto& pin : meta_b.m_pins) {
-		meta_a.m_pins.push_back(pin);
-		m_pin_nodes[pin] = node_a;
-	}
-
-    for (const auto &comp : meta_b.m_dependents) {
-        meta_a.m_dependents.insert(comp);
-    }
-
-    return node_a;
+    m_topology.reset();
 }
 
 void Simulator::node_set_default(node_t node_id, Value value) {
-    assert(node_id < m_node_metadata.size());
-    m_node_metadata[node_id].m_default = value;
+    assert(node_id < m_node_defaults.size());
+    m_node_defaults.set(node_id, value);
 }
 
 void Simulator::node_set_initial_value(node_t node_id, Value value) {
-    assert(node_id < m_node_metadata.size());
-    m_node_values_read[node_id] = value;
-    m_node_values_write[node_id] = value;
-    m_node_write_time[node_id] = m_time;
-    m_node_change_time[node_id] = m_time;
-}
-
-void Simulator::write_node(node_t node_id, Value value, pin_t from_pin) {
-    assert(node_id < m_node_values_write.size());
-	auto &node_meta = m_node_metadata[node_id];
-
-	if (node_meta.m_time_dirty_write != m_time) {
-		m_dirty_nodes_write.push_back(node_id);
-		node_meta.m_time_dirty_write = m_time;
-	}
-
-    if (value == VALUE_UNDEFINED) {
-        // remove from active pin list
-		node_meta.m_active_pins.erase(from_pin);
-        return;
-    }
-
-    m_node_write_time[node_id] = m_time;
-    m_node_values_write[node_id] = value;
-    node_meta.m_active_pins.insert(from_pin);
-}
-
-Value Simulator::read_node(node_t node_id) const {
     assert(node_id < m_node_values_read.size());
-    return m_node_values_read[node_id];
+    m_node_values_read.set(node_id, value);
+    m_node_values_write.set(node_id, value);
+    m_node_change_epoch[node_id] = m_epoch;
 }
 
 Value Simulator::read_node_current_step(node_t node_id) const {
@@ -243,19 +301,71 @@ Value Simulator::read_node_current_step(node_t node_id) const {
 }
 
 bool Simulator::node_changed_previous_step(node_t node_id) const {
-    assert(node_id < m_node_change_time.size());
-    return m_node_change_time[node_id] == m_time - 1;
+    assert(node_id < m_node_change_epoch.size());
+    return node_change_time(node_id) == m_time - 1;
 }
 
 timestamp_t Simulator::node_last_change_time(node_t node_id) const {
-    assert(node_id < m_node_change_time.size());
-    return m_node_change_time[node_id];
+    assert(node_id < m_node_change_epoch.size());
+    return node_change_time(node_id);
+}
+
+timestamp_t Simulator::node_change_time(node_t node_id) const {
+    auto epoch = m_node_change_epoch[node_id];
+    return (epoch != EPOCH_NONE) ? m_epoch_time[epoch] : m_node_change_time[node_id];
 }
 
 bool Simulator::node_dirty(node_t node_id) const {
-    assert(node_id < m_node_change_time.size());
-	// if this ends up being a hotspot in a profiler: change to a timestamp-flag in the node metadata?
-	return std::find(std::begin(m_dirty_nodes_read), std::end(m_dirty_nodes_read), node_id) != std::end(m_dirty_nodes_read);
+    assert(node_id < m_node_change_epoch.size());
+	// every node that changed in the last step has the current epoch (including the ones that were resolved
+	//  during the levelized evaluation and aren't in the dirty list)
+	return m_all_nodes_dirty || m_node_change_epoch[node_id] == m_epoch;
+}
+
+pin_t Simulator::node_driver(node_t node_id) const {
+    assert(!m_topology_dirty);
+    assert(node_id < m_topology->m_node_driver.size());
+    return m_topology->m_node_driver[node_id];
+}
+
+uint64_t Simulator::changed_nodes_since(uint64_t generation, node_container_t &changed) {
+    changed.clear();
+
+    if (!m_track_changes || generation < m_change_log_start || generation > m_generation) {
+        // start logging now: report everything, the next call only gets the changes
+        m_track_changes = true;
+        m_change_log.clear();
+        m_change_log_offsets.clear();
+        m_change_log_start = m_generation;
+
+        changed.resize(m_node_values_read.size());
+        for (node_t node_id = 0; node_id < changed.size(); ++node_id) {
+            changed[node_id] = node_id;
+        }
+        return m_generation;
+    }
+
+    if (generation == m_generation) {
+        return m_generation;
+    }
+
+    // a node can change in several steps: report it only once
+    m_node_reported.resize(m_node_values_read.size(), false);
+    auto first = m_change_log_offsets[generation - m_change_log_start];
+
+    for (auto idx = first; idx < m_change_log.size(); ++idx) {
+        auto node_id = m_change_log[idx];
+        if (!m_node_reported[node_id]) {
+            m_node_reported[node_id] = true;
+            changed.push_back(node_id);
+        }
+    }
+
+    for (auto node_id : changed) {
+        m_node_reported[node_id] = false;
+    }
+
+    return m_generation;
 }
 
 void Simulator::register_sim_function(ComponentType comp_type, SimFuncType func_type, simulation_func_t func) {
@@ -263,36 +373,540 @@ void Simulator::register_sim_function(ComponentType comp_type, SimFuncType func_
     assert(func_type <= 3);
 
     if (m_sim_functions.size() <= comp_type) {
-        m_sim_functions.resize(COMPONENT_MAX_TYPE_ID + 1, {nullptr, [](auto, auto) {}, nullptr});
+        m_sim_functions.resize(COMPONENT_MAX_TYPE_ID + 1, {nullptr, nullptr, nullptr});
     }
 
     m_sim_functions[comp_type][func_type] = move(func);
 }
 
+void Simulator::register_batch_function(ComponentType comp_type, simulation_batch_func_t func) {
+    assert(comp_type <= COMPONENT_MAX_TYPE_ID);
+    assert(func != nullptr);
+
+    auto found = std::find(m_batch_types.begin(), m_batch_types.end(), comp_type);
+    if (found != m_batch_types.end()) {
+        m_batch_functions[found - m_batch_types.begin()] = func;
+        return;
+    }
+
+    assert(m_batch_types.size() < BATCH_NONE);
+    m_batch_types.push_back(comp_type);
+    m_batch_functions.push_back(func);
+    m_dirty_batches.emplace_back();
+}
+
 bool Simulator::component_has_function(ComponentType comp_type, SimFuncType func_type) {
     assert(comp_type <= COMPONENT_MAX_TYPE_ID);
     assert(func_type <= 3);
     return m_sim_functions[comp_type][func_type] != nullptr;
 }
 
+void Simulator::finalize() {
+    if (!m_topology_dirty) {
+        return;
+    }
+
+    auto topology = std::make_shared<SimTopology>();
+
+    // component topology
+    topology->m_component_batch.assign(m_components.size(), BATCH_NONE);
+
+    std::vector<bool> reactive(m_components.size(), false);
+
+    for (const auto &comp : m_components) {
+        auto type = comp.description()->type();
+
+        auto batch = std::find(m_batch_types.begin(), m_batch_types.end(), type);
+        if (batch != m_batch_types.end()) {
+            topology->m_component_batch[comp.id()] = static_cast<uint8_t>(batch - m_batch_types.begin());
+        }
+
+        reactive[comp.id()] = topology->m_component_batch[comp.id()] != BATCH_NONE ||
+                               component_has_function(type, SIM_FUNCTION_INPUT_CHANGED);
+    }
+
+    // propagation delays
+    m_component_timing.clear();
+    m_timed_pins.clear();
+    m_pin_timed.assign(m_pin_nodes.size(), TIMED_PIN_NONE);
+
+    for (const auto &comp : m_components) {
+        auto desc = comp.description();
+        if (desc->property("delay_rise") == nullptr && desc->property("delay_fall") == nullptr) {
+            continue;
+        }
+
+        auto delay = [desc](const char *key, int64_t def_value) {
+            return static_cast<uint32_t>(std::max<int64_t>(1, desc->property_value(key, def_value)));
+        };
+
+        ComponentTiming timing;
+        timing.m_rise[1] = delay("delay_rise", 1);
+        timing.m_rise[0] = delay("delay_rise_min", timing.m_rise[1]);
+        timing.m_rise[2] = delay("delay_rise_max", timing.m_rise[1]);
+        timing.m_fall[1] = delay("delay_fall", 1);
+        timing.m_fall[0] = delay("delay_fall_min", timing.m_fall[1]);
+        timing.m_fall[2] = delay("delay_fall_max", timing.m_fall[1]);
+
+        auto timing_idx = static_cast<uint32_t>(m_component_timing.size());
+        m_component_timing.push_back(timing);
+
+        for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+            m_pin_timed[comp.pin_by_index(comp.output_pin_index(idx))] = static_cast<uint32_t>(m_timed_pins.size());
+            m_timed_pins.push_back({timing_idx, 1, 1, 0});
+        }
+    }
+
+    // node topology
+    std::vector<bool> merged(m_components.size(), false);
+    build_nodes(*topology);
+    if (m_netlist_optimizations & OPTIMIZE_MERGE_GATES) {
+        merge_gates(*topology, reactive, merged);
+    }
+    if (m_netlist_optimizations & OPTIMIZE_CONSTANTS) {
+        optimize_constants(*topology, reactive, merged);
+    }
+    build_dependents(*topology, reactive);
+    auto num_nodes = topology->m_node_pins.num_rows();
+
+    // driver resolution: a node with only one output pin that can drive it can't have multiple active drivers
+    //  (merged gates never write to their pins either)
+    topology->m_node_driver.assign(num_nodes, PIN_UNDEFINED);
+    auto num_drivers = count_node_drivers(num_nodes, merged, &topology->m_node_driver);
+
+    for (node_t node_id = 0; node_id < num_drivers.size(); ++node_id) {
+        if (num_drivers[node_id] != 1) {
+            topology->m_node_driver[node_id] = PIN_UNDEFINED;
+        }
+    }
+
+    // levels are only computed when they are needed
+    m_levels_valid = false;
+    m_level_batches.clear();
+
+    // multi-threading
+    m_pin_deferred.assign(m_pin_nodes.size(), false);
+    m_deferred_values.assign(m_pin_nodes.size(), VALUE_UNDEFINED);
+
+    m_topology = std::move(topology);
+    m_topology_dirty = false;
+}
+
+void Simulator::build_nodes(SimTopology &topology) {
+    auto num_pins = m_pin_parent.size();
+
+    // dense node ids, in the order of the lowest pin of each group of connected pins
+    node_t num_nodes = 0;
+    m_pin_nodes.assign(num_pins, NODE_INVALID);
+
+    for (pin_t pin = 0; pin < num_pins; ++pin) {
+        auto root = pin_root(pin);
+        if (m_pin_nodes[root] == NODE_INVALID) {
+            m_pin_nodes[root] = num_nodes++;
+        }
+        m_pin_nodes[pin] = m_pin_nodes[root];
+    }
+
+    build_node_pins(topology, num_nodes);
+}
+
+std::vector<uint32_t> Simulator::count_node_drivers(node_t num_nodes, const std::vector<bool> &merged,
+                                                    pin_container_t *last_driver) const {
+    count_container_t num_drivers(num_nodes, 0);
+
+    for (const auto &comp : m_components) {
+        if (merged[comp.id()] || !can_drive(comp)) {
+            continue;
+        }
+        for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+            auto pin = comp.pin_by_index(comp.output_pin_index(idx));
+            num_drivers[m_pin_nodes[pin]] += 1;
+            if (last_driver) {
+                (*last_driver)[m_pin_nodes[pin]] = pin;
+            }
+        }
+    }
+
+    return num_drivers;
+}
+
+void Simulator::build_node_pins(SimTopology &topology, node_t num_nodes) {
+    auto num_pins = m_pin_nodes.size();
+
+    // pins of the nodes (counting sort)
+    count_container_t counts(num_nodes, 0);
+    for (pin_t pin = 0; pin < num_pins; ++pin) {
+        counts[m_pin_nodes[pin]] += 1;
+    }
+
+    topology.m_node_pins.assign_row_sizes(counts);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (pin_t pin = 0; pin < num_pins; ++pin) {
+        auto node_id = m_pin_nodes[pin];
+        topology.m_node_pins.row_begin(node_id)[counts[node_id]++] = pin;
+    }
+
+    // node state
+    m_node_values_read.assign(num_nodes, VALUE_UNDEFINED);
+    m_node_values_write.assign(num_nodes, VALUE_UNDEFINED);
+    m_node_defaults.assign(num_nodes, VALUE_UNDEFINED);
+    m_node_active_pins.assign(num_nodes, 0);
+    m_node_time_dirty_write.assign(num_nodes, EPOCH_NONE);
+    m_node_change_epoch.assign(num_nodes, EPOCH_NONE);
+    m_node_change_time.assign(num_nodes, 0);
+    m_dirty_nodes_read.clear();
+    m_dirty_nodes_write.clear();
+}
+
+void Simulator::build_dependents(SimTopology &topology, const std::vector<bool> &reactive) {
+    auto num_nodes = topology.m_node_pins.num_rows();
+
+    // dependents: the components that react to input changes, once per node (in order of component id)
+    count_container_t counts(num_nodes, 0);
+    count_container_t last_dependent(num_nodes, static_cast<uint32_t>(-1));
+
+    auto for_each_dependent = [&](auto func) {
+        for (const auto &comp : m_components) {
+            if (!reactive[comp.id()]) {
+                continue;
+            }
+            auto pins = component_pins(comp.id());
+            for (auto idx = 0u; idx < comp.num_pins(); ++idx) {
+                if (idx >= comp.num_inputs() && idx < comp.control_pin_index(0)) {
+                    continue;
+                }
+                auto node_id = m_pin_nodes[pins[idx]];
+                if (last_dependent[node_id] != comp.id()) {
+                    last_dependent[node_id] = comp.id();
+                    func(node_id, comp.id());
+                }
+            }
+        }
+    };
+
+    for_each_dependent([&](node_t node_id, uint32_t) {counts[node_id] += 1;});
+    topology.m_node_dependents.assign_row_sizes(counts);
+
+    std::fill(counts.begin(), counts.end(), 0);
+    std::fill(last_dependent.begin(), last_dependent.end(), static_cast<uint32_t>(-1));
+    for_each_dependent([&](node_t node_id, uint32_t comp_id) {
+        topology.m_node_dependents.row_begin(node_id)[counts[node_id]++] = comp_id;
+    });
+}
+
+void Simulator::optimize_constants(SimTopology &topology, std::vector<bool> &reactive,
+                                   const std::vector<bool> &merged) {
+    const uint8_t NOT_CONSTANT = 0xff;
+    auto num_nodes = topology.m_node_pins.num_rows();
+
+    // the component of each pin (the pins of a component are consecutive), the number of pins that can drive each
+    //  node and the number of constants and pull resistors connected to each node
+    count_container_t pin_component(m_pin_nodes.size(), 0);
+    count_container_t node_constants(num_nodes, 0);
+    auto node_drivers = count_node_drivers(num_nodes, merged);
+
+    for (const auto &comp : m_components) {
+        auto pins = component_pins(comp.id());
+        for (auto idx = 0u; idx < comp.num_pins(); ++idx) {
+            pin_component[pins[idx]] = comp.id();
+        }
+        auto type = comp.description()->type();
+        if (type == COMPONENT_CONSTANT || type == COMPONENT_PULL_RESISTOR) {
+            node_constants[m_pin_nodes[pins[0]]] += 1;
+        }
+    }
+
+    auto is_input_pin = [&](pin_t pin) {
+        const auto &comp = m_components[pin_component[pin]];
+        auto idx = pin - component_pins(comp.id())[0];
+        return idx < comp.num_inputs() || idx >= comp.control_pin_index(0);
+    };
+
+    // constant propagation: a node is constant when it isn't driven and has a single constant or pull resistor, or
+    //  when its only driver is a gate with constant inputs (the gate is folded). Sub-circuit ports don't drive
+    //  their nodes, so constants propagate into and out of nested circuits.
+    std::vector<uint8_t> node_value(num_nodes, NOT_CONSTANT);
+    count_container_t pending_inputs(m_components.size(), 0);
+    std::vector<bool> folded(m_components.size(), false);
+    node_container_t worklist;
+
+    for (const auto &comp : m_components) {
+        auto type = comp.description()->type();
+        if (is_foldable(type)) {
+            pending_inputs[comp.id()] = static_cast<uint32_t>(comp.num_inputs());
+        }
+        if (type != COMPONENT_CONSTANT && type != COMPONENT_PULL_RESISTOR) {
+            continue;
+        }
+        auto node_id = m_pin_nodes[comp.pin_by_index(0)];
+        if (node_drivers[node_id] == 0 && node_constants[node_id] == 1) {
+            auto prop = comp.description()->property(type == COMPONENT_CONSTANT ? "value" : "pull_to");
+            node_value[node_id] = prop->value_as_lsim_value();
+            worklist.push_back(node_id);
+        }
+    }
+
+    value_container_t inputs;
+
+    for (size_t head = 0; head < worklist.size(); ++head) {
+        auto node_pins = topology.m_node_pins.row_begin(worklist[head]);
+        auto node_pins_end = topology.m_node_pins.row_end(worklist[head]);
+
+        for (auto pin = node_pins; pin != node_pins_end; ++pin) {
+            const auto &comp = m_components[pin_component[*pin]];
+            auto type = comp.description()->type();
+            if (!is_foldable(type) || merged[comp.id()] || !is_input_pin(*pin) || --pending_inputs[comp.id()] > 0) {
+                continue;
+            }
+
+            // all inputs are constant: fold the gate when it's the only driver of its outputs
+            auto pins = component_pins(comp.id());
+            bool single_driver = true;
+            for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+                single_driver &= node_drivers[m_pin_nodes[pins[comp.output_pin_index(idx)]]] == 1;
+            }
+            if (!single_driver) {
+                continue;
+            }
+
+            inputs.clear();
+            for (auto idx = 0u; idx < comp.num_inputs(); ++idx) {
+                inputs.push_back(static_cast<Value>(node_value[m_pin_nodes[pins[idx]]]));
+            }
+
+            for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+                auto output = (type == COMPONENT_BUFFER) ? inputs[idx] : fold_gate(type, inputs.data(), inputs.size());
+                auto node_id = m_pin_nodes[pins[comp.output_pin_index(idx)]];
+                node_value[node_id] = output;
+                topology.m_constant_nodes.push_back({node_id, output});
+                worklist.push_back(node_id);
+            }
+            folded[comp.id()] = true;
+        }
+    }
+
+    // dead logic: only the gates that (indirectly) drive an observed node or an input of a component that
+    //  isn't a gate are evaluated. Connectors, vias and sub-circuits are only observed when marked as such.
+    std::vector<bool> node_live(num_nodes, false);
+    std::vector<bool> comp_live(m_components.size(), false);
+    worklist.clear();
+
+    auto make_live = [&](node_t node_id) {
+        if (!node_live[node_id]) {
+            node_live[node_id] = true;
+            worklist.push_back(node_id);
+        }
+    };
+
+    for (pin_t pin = 0; pin < m_pin_observed.size(); ++pin) {
+        if (m_pin_observed[pin]) {
+            make_live(m_pin_nodes[pin]);
+        }
+    }
+
+    for (const auto &comp : m_components) {
+        auto type = comp.description()->type();
+        if (is_removable(type) || type == COMPONENT_CONNECTOR_IN || type == COMPONENT_CONNECTOR_OUT ||
+            type == COMPONENT_VIA || type == COMPONENT_SUB_CIRCUIT) {
+            continue;
+        }
+        auto pins = component_pins(comp.id());
+        for (auto idx = 0u; idx < comp.num_pins(); ++idx) {
+            if (is_input_pin(pins[idx])) {
+                make_live(m_pin_nodes[pins[idx]]);
+            }
+        }
+    }
+
+    while (!worklist.empty()) {
+        auto node_id = worklist.back();
+        worklist.pop_back();
+
+        for (auto pin = topology.m_node_pins.row_begin(node_id); pin != topology.m_node_pins.row_end(node_id); ++pin) {
+            const auto &comp = m_components[pin_component[*pin]];
+            if (!is_removable(comp.description()->type()) || folded[comp.id()] || merged[comp.id()] ||
+                comp_live[comp.id()] || is_input_pin(*pin)) {
+                continue;
+            }
+            comp_live[comp.id()] = true;
+
+            auto pins = component_pins(comp.id());
+            for (auto idx = 0u; idx < comp.num_pins(); ++idx) {
+                if (is_input_pin(pins[idx])) {
+                    make_live(m_pin_nodes[pins[idx]]);
+                }
+            }
+        }
+    }
+
+    // folded and dead gates don't react to their inputs anymore
+    for (const auto &comp : m_components) {
+        if (!is_removable(comp.description()->type()) || merged[comp.id()]) {
+            continue;
+        }
+        if (folded[comp.id()]) {
+            topology.m_reduction.m_folded_gates += 1;
+            reactive[comp.id()] = false;
+        } else if (!comp_live[comp.id()]) {
+            topology.m_reduction.m_dead_gates += 1;
+            reactive[comp.id()] = false;
+        }
+    }
+}
+
+void Simulator::merge_gates(SimTopology &topology, std::vector<bool> &reactive, std::vector<bool> &merged) {
+    auto num_nodes = topology.m_node_pins.num_rows();
+
+    // only gates that are the only driver of their outputs (no tri-state or wired outputs) and that don't have a
+    //  propagation delay are merged
+    auto node_drivers = count_node_drivers(num_nodes, merged);
+
+    count_container_t candidates;
+    for (const auto &comp : m_components) {
+        if (!is_foldable(comp.description()->type())) {
+            continue;
+        }
+        bool mergeable = true;
+        for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+            auto pin = comp.pin_by_index(comp.output_pin_index(idx));
+            mergeable &= node_drivers[m_pin_nodes[pin]] == 1 && m_pin_timed[pin] == TIMED_PIN_NONE;
+        }
+        if (mergeable) {
+            candidates.push_back(comp.id());
+        }
+    }
+
+    // union-find of the nodes: the output nodes of a merged gate join the output nodes of the original gate
+    node_container_t node_parent(num_nodes);
+    std::iota(node_parent.begin(), node_parent.end(), 0);
+
+    auto node_root = [&node_parent](node_t node_id) {
+        while (node_parent[node_id] != node_id) {
+            node_parent[node_id] = node_parent[node_parent[node_id]];
+            node_id = node_parent[node_id];
+        }
+        return node_id;
+    };
+
+    // key of a gate: type, initial output and input nodes (sorted, except for the bits of a buffer).
+    //  Merging gates can make the gates that use their outputs equal: repeat until nothing changes.
+    std::unordered_map<std::vector<uint32_t>, uint32_t, GateKeyHash> lut;
+    std::vector<uint32_t> key;
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+        lut.clear();
+
+        for (auto comp_id : candidates) {
+            if (merged[comp_id]) {
+                continue;
+            }
+
+            const auto &comp = m_components[comp_id];
+            auto type = comp.description()->type();
+            auto pins = component_pins(comp_id);
+
+            key.clear();
+            key.push_back(type);
+            key.push_back(comp.description()->property_value("initial_output", VALUE_UNDEFINED));
+            for (auto idx = 0u; idx < comp.num_inputs(); ++idx) {
+                key.push_back(node_root(m_pin_nodes[pins[idx]]));
+            }
+            if (type != COMPONENT_BUFFER) {
+                std::sort(key.begin() + 2, key.end());
+            }
+
+            auto found = lut.emplace(key, comp_id);
+            if (found.second) {
+                continue;
+            }
+
+            auto original = component_pins(found.first->second);
+            for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+                auto out_idx = comp.output_pin_index(idx);
+                node_parent[node_root(m_pin_nodes[pins[out_idx]])] = node_root(m_pin_nodes[original[out_idx]]);
+            }
+
+            merged[comp_id] = true;
+            reactive[comp_id] = false;
+            topology.m_reduction.m_merged_gates += 1;
+            changed = true;
+        }
+    }
+
+    if (topology.m_reduction.m_merged_gates == 0) {
+        return;
+    }
+
+    // dense node ids again, in the order of the lowest pin of each node
+    node_container_t node_ids(num_nodes, NODE_INVALID);
+    node_t num_merged_nodes = 0;
+
+    for (auto &node_id : m_pin_nodes) {
+        auto root = node_root(node_id);
+        if (node_ids[root] == NODE_INVALID) {
+            node_ids[root] = num_merged_nodes++;
+        }
+        node_id = node_ids[root];
+    }
+
+    build_node_pins(topology, num_merged_nodes);
+}
+
+void Simulator::set_netlist_optimizations(uint32_t flags) {
+    assert(!m_is_fork);
+
+    if (flags != m_netlist_optimizations) {
+        m_netlist_optimizations = flags;
+        m_topology_dirty = true;
+    }
+}
+
+NetlistReduction Simulator::netlist_reduction() const {
+    return (m_topology != nullptr) ? m_topology->m_reduction : NetlistReduction();
+}
+
+void Simulator::set_num_threads(size_t num_threads) {
+    assert(num_threads >= 1);
+
+    m_num_threads = num_threads;
+    if (num_threads > 1) {
+        m_workers.start(num_threads);
+    } else {
+        m_workers.stop();
+    }
+}
+
 void Simulator::init() {
+    finalize();
+
     m_time = 1;
+    m_epoch = 1;
+    m_epoch_time.assign(EPOCH_PERIOD, 0);
+    m_epoch_time[m_epoch] = m_time;
 
-    std::fill(std::begin(m_node_values_read), std::end(m_node_values_read), VALUE_FALSE);
-    std::fill(std::begin(m_node_values_write), std::end(m_node_values_write), VALUE_FALSE);
-    std::fill(std::begin(m_node_write_time), std::end(m_node_write_time), 0);
+    m_node_values_read.fill(VALUE_FALSE);
+    m_node_values_write.fill(VALUE_FALSE);
+    std::fill(std::begin(m_node_change_epoch), std::end(m_node_change_epoch), EPOCH_NONE);
     std::fill(std::begin(m_node_change_time), std::end(m_node_change_time), 0);
-	std::fill(std::begin(m_input_changed), std::end(m_input_changed), 0);
-
-    for (auto &meta : m_node_metadata) {
-        meta.m_default = VALUE_UNDEFINED;
-		meta.m_active_pins.clear();
-		meta.m_time_dirty_write = 0;
+	std::fill(std::begin(m_input_changed), std::end(m_input_changed), EPOCH_NONE);
+    std::fill(std::begin(m_scheduled_time), std::end(m_scheduled_time), 0);
+    m_scheduled_components.clear(m_time);
+    m_delayed_writes.clear(m_time);
+    resolve_propagation_delays();
+    m_levelized = m_timing_mode == TIMING_LEVELIZED;
+    if (m_levelized && !m_levels_valid) {
+        levelize();
     }
+    m_node_defaults.fill(VALUE_UNDEFINED);
+    std::fill(std::begin(m_node_active_pins), std::end(m_node_active_pins), 0);
+    std::fill(std::begin(m_node_time_dirty_write), std::end(m_node_time_dirty_write), EPOCH_NONE);
+    std::fill(std::begin(m_pin_active), std::end(m_pin_active), false);
 
     // apply initial values
     for (auto &comp : m_components) {
-		comp->apply_initial_values();
+		comp.apply_initial_values();
     }
 
     // run one time setup functions
@@ -301,27 +915,244 @@ void Simulator::init() {
         setup_func(this, comp);
     }
 
+    // the outputs of the folded gates
+    for (const auto &constant : m_topology->m_constant_nodes) {
+        m_node_defaults.set(constant.first, constant.second);
+        node_set_initial_value(constant.first, constant.second);
+    }
+
     // mark all nodes as dirty for the first run
     for (node_t node = 0; node < m_node_values_read.size(); ++node) {
         m_dirty_nodes_read.push_back(node);
     }
+    m_all_nodes_dirty = true;
+
+    // clients that track changes have to refresh all nodes
+    m_generation += 1;
+    m_change_log.clear();
+    m_change_log_offsets.clear();
+    m_change_log_start = m_generation;
+
+    reset_watchpoints();
+}
+
+Simulator::Snapshot Simulator::snapshot() const {
+    assert(!m_topology_dirty);
+    assert(m_epoch != EPOCH_NONE);          // init() must have been called
+
+    Snapshot result;
+    result.m_topology = m_topology;
+    result.m_time = m_time;
+    result.m_epoch = m_epoch;
+    result.m_epoch_time = m_epoch_time;
+
+    result.m_input_changed = m_input_changed;
+    for (auto comp : m_independent_components) {
+        result.m_independent_components.push_back(comp->id());
+    }
+    result.m_scheduled_components = m_scheduled_components;
+    result.m_scheduled_time = m_scheduled_time;
+
+    result.m_delays_active = m_delays_active;
+    result.m_timed_pins = m_timed_pins;
+    result.m_delayed_writes = m_delayed_writes;
+    result.m_levelized = m_levelized;
+
+    result.m_pin_values = m_pin_values;
+    result.m_pin_active = m_pin_active;
+
+    result.m_node_defaults = m_node_defaults;
+    result.m_node_active_pins = m_node_active_pins;
+    result.m_node_time_dirty_write = m_node_time_dirty_write;
+    result.m_node_values_read = m_node_values_read;
+    result.m_node_values_write = m_node_values_write;
+    result.m_dirty_nodes_read = m_dirty_nodes_read;
+    result.m_dirty_nodes_write = m_dirty_nodes_write;       // written outside of a step, resolved by the next step
+    result.m_node_change_epoch = m_node_change_epoch;
+    result.m_node_change_time = m_node_change_time;
+    result.m_all_nodes_dirty = m_all_nodes_dirty;
+    result.m_nodes_changed = m_nodes_changed;
+
+    result.m_user_values = m_user_values;
+    result.m_extra_data = m_extra_data;
+
+    return result;
+}
+
+bool Simulator::restore(const Snapshot &snapshot) {
+    // the snapshot has to be taken from this simulator (or a fork) and the netlist can't have changed since
+    if (m_topology_dirty || snapshot.m_topology != m_topology ||
+        snapshot.m_pin_active.size() != m_pin_active.size() ||
+        snapshot.m_node_values_read.size() != m_node_values_read.size() ||
+        snapshot.m_input_changed.size() != m_input_changed.size() ||
+        snapshot.m_user_values.size() != m_user_values.size() ||
+        snapshot.m_extra_data.size() != m_extra_data.size() ||
+        (snapshot.m_levelized && !m_levels_valid)) {
+        ERROR_MSG("Snapshot doesn't match the netlist of the simulator%s", "");
+        return false;
+    }
+
+    assign_state(snapshot);
+    return true;
+}
+
+std::unique_ptr<Simulator> Simulator::fork() const {
+    assert(!m_topology_dirty);
+    assert(m_epoch != EPOCH_NONE);          // init() must have been called
+
+    auto result = std::make_unique<Simulator>();
+    result->m_is_fork = true;
+
+    // configuration
+    result->m_sim_functions = m_sim_functions;
+    result->m_batch_functions = m_batch_functions;
+    result->m_batch_types = m_batch_types;
+    result->m_dirty_batches.resize(m_dirty_batches.size());
+    result->m_timing_mode = m_timing_mode;
+    result->m_timing_seed = m_timing_seed;
+    result->m_parallel_threshold = m_parallel_threshold;
+    result->m_netlist_optimizations = m_netlist_optimizations;
+
+    // components: handles to the same component descriptions
+    for (const auto &comp : m_components) {
+        result->m_components.emplace_back(result.get(), comp);
+    }
+
+    auto fork_refs = [&result](const component_refs_t &refs) {
+        component_refs_t fork_refs;
+        for (auto comp : refs) {
+            fork_refs.push_back(&result->m_components[comp->id()]);
+        }
+        return fork_refs;
+    };
+    result->m_init_components = fork_refs(m_init_components);
+    result->m_clocks = fork_refs(m_clocks);
+    result->m_component_pins = m_component_pins;
+    result->m_lookup_tables = m_lookup_tables;
+
+    // netlist
+    result->m_topology = m_topology;
+    result->m_pin_parent = m_pin_parent;
+    result->m_pin_nodes = m_pin_nodes;
+    result->m_component_timing = m_component_timing;
+    result->m_pin_timed = m_pin_timed;
+    result->m_levels_valid = m_levels_valid;
+    result->m_component_level = m_component_level;
+    result->m_level_batches = m_level_batches;
+    result->m_pin_deferred.assign(m_pin_deferred.size(), false);
+    result->m_deferred_values.assign(m_deferred_values.size(), VALUE_UNDEFINED);
+
+    // simulation state
+    result->m_generation = m_generation;
+    result->assign_state(snapshot());
+
+    return result;
+}
+
+void Simulator::assign_state(const Snapshot &snapshot) {
+    // assignment reuses the storage of the containers: no allocations when restoring the same snapshot repeatedly
+    m_time = snapshot.m_time;
+    m_epoch = snapshot.m_epoch;
+    m_epoch_time = snapshot.m_epoch_time;
+
+    m_input_changed = snapshot.m_input_changed;
+    m_independent_components.clear();
+    for (auto comp_id : snapshot.m_independent_components) {
+        m_independent_components.push_back(&m_components[comp_id]);
+    }
+    m_scheduled_components = snapshot.m_scheduled_components;
+    m_scheduled_time = snapshot.m_scheduled_time;
+
+    m_delays_active = snapshot.m_delays_active;
+    m_timed_pins = snapshot.m_timed_pins;
+    m_delayed_writes = snapshot.m_delayed_writes;
+    m_levelized = snapshot.m_levelized;
+
+    m_pin_values = snapshot.m_pin_values;
+    m_pin_active = snapshot.m_pin_active;
+
+    m_node_defaults = snapshot.m_node_defaults;
+    m_node_active_pins = snapshot.m_node_active_pins;
+    m_node_time_dirty_write = snapshot.m_node_time_dirty_write;
+    m_node_values_read = snapshot.m_node_values_read;
+    m_node_values_write = snapshot.m_node_values_write;
+    m_dirty_nodes_read = snapshot.m_dirty_nodes_read;
+    m_dirty_nodes_write = snapshot.m_dirty_nodes_write;
+    m_node_change_epoch = snapshot.m_node_change_epoch;
+    m_node_change_time = snapshot.m_node_change_time;
+    m_all_nodes_dirty = snapshot.m_all_nodes_dirty;
+    m_nodes_changed = snapshot.m_nodes_changed;
+
+    m_user_values = snapshot.m_user_values;
+    m_extra_data = snapshot.m_extra_data;
+
+    // clients that track changes have to refresh all nodes
+    m_generation += 1;
+    m_change_log.clear();
+    m_change_log_offsets.clear();
+    m_change_log_start = m_generation;
+
+    reset_watchpoints();
 }
 
 void Simulator::step() {
+    assert(!m_topology_dirty);
+
     m_time = m_time + 1;
+    if (++m_epoch == EPOCH_PERIOD) {
+        renumber_epochs();
+    }
+    m_epoch_time[m_epoch] = m_time;
+    m_all_nodes_dirty = false;
+    m_nodes_changed = 0;
 	m_dirty_components.clear();
+    m_levelized_changes.clear();
+    m_watch_hits.clear();
+
+    m_generation += 1;
+    if (m_track_changes) {
+        if (m_change_log.size() + m_change_log_offsets.size() > CHANGE_LOG_LIMIT) {
+            m_change_log.clear();
+            m_change_log_offsets.clear();
+            m_change_log_start = m_generation - 1;
+        }
+        m_change_log_offsets.push_back(m_change_log.size());
+    }
 
-    // >> build a unique list of components with changed input values
+    // >> build a unique list of components with changed input values, bucketed by batch function
+    const auto &dependents = m_topology->m_node_dependents;
     for (auto node_id : m_dirty_nodes_read) {
-        for (auto comp : m_node_metadata[node_id].m_dependents) {
-			if (m_input_changed[comp->id()] != m_time) {
-				m_dirty_components.push_back(comp);
-				m_input_changed[comp->id()] = m_time;
-			}
+        for (auto dep = dependents.row_begin(node_id); dep != dependents.row_end(node_id); ++dep) {
+            mark_component_dirty(*dep);
+        }
+    }
+
+    // >> run simulation: acyclic combinational logic, in level order
+    if (m_levelized) {
+        run_levelized();
+    }
+
+    // >> run simulation: changed inputs - batched
+    size_t num_batched = 0;
+    for (const auto &comp_ids : m_dirty_batches) {
+        num_batched += comp_ids.size();
+    }
+    m_step_stats.m_dirty_components = num_batched;
+    m_step_stats.m_parallel = m_num_threads > 1 && num_batched >= m_parallel_threshold;
+
+    if (m_step_stats.m_parallel) {
+        run_batches_parallel();
+    } else {
+        for (size_t batch = 0; batch < m_dirty_batches.size(); ++batch) {
+            auto &comp_ids = m_dirty_batches[batch];
+            if (!comp_ids.empty()) {
+                m_batch_functions[batch](this, comp_ids.data(), comp_ids.size());
+                comp_ids.clear();
+            }
         }
     }
 
-    // >> run simulation: changed inputs
+    // >> run simulation: changed inputs - components without a batch function
     for (auto comp : m_dirty_components) {
         auto &input_func = m_sim_functions[comp->description()->type()][SIM_FUNCTION_INPUT_CHANGED];
         input_func(this, comp);
@@ -333,28 +1164,476 @@ void Simulator::step() {
         func(this, comp);
     }
 
+    // >> run simulation: scheduled components
+    m_scheduled_components.pop_due(m_time, [this](uint32_t comp_id) {
+        auto comp = &m_components[comp_id];
+        auto &func = m_sim_functions[comp->description()->type()][SIM_FUNCTION_INDEPENDENT];
+        func(this, comp);
+    });
+
+    // >> apply delayed writes whose propagation delay has passed
+    if (m_delays_active) {
+        m_delayed_writes.pop_due(m_time, [this](const PendingWrite &write) {
+            auto &timed = m_timed_pins[m_pin_timed[write.m_pin]];
+            if (timed.m_sequence == write.m_sequence) {
+                m_pin_values.set(write.m_pin, write.m_value);
+                write_node(m_pin_nodes[write.m_pin], write.m_value, write.m_pin);
+            }
+        });
+    }
+
     // >> post-process the dirty nodes
     m_dirty_nodes_read.clear();
     postprocess_dirty_nodes();
+
+    if (!m_watchpoints.empty()) {
+        check_watchpoints(m_levelized_changes);
+        check_watchpoints(m_dirty_nodes_read);
+    }
+
+    if (m_track_changes) {
+        m_change_log.insert(std::end(m_change_log), std::begin(m_levelized_changes), std::end(m_levelized_changes));
+        m_change_log.insert(std::end(m_change_log), std::begin(m_dirty_nodes_read), std::end(m_dirty_nodes_read));
+    }
+}
+
+inline void Simulator::mark_component_dirty(uint32_t comp_id) {
+    if (m_input_changed[comp_id] == m_epoch) {
+        return;
+    }
+    m_input_changed[comp_id] = m_epoch;
+
+    auto batch = m_topology->m_component_batch[comp_id];
+    if (batch == BATCH_NONE) {
+        m_dirty_components.push_back(&m_components[comp_id]);
+    } else if (m_levelized && m_component_level[comp_id] != LEVEL_NONE) {
+        m_level_batches[m_component_level[comp_id]][batch].push_back(comp_id);
+    } else {
+        m_dirty_batches[batch].push_back(comp_id);
+    }
+}
+
+void Simulator::run_levelized() {
+    const auto &dependents = m_topology->m_node_dependents;
+
+    // the nodes written by a level are resolved right away: the next levels see the new values in the same step
+    for (size_t level = 0; level < m_level_batches.size(); ++level) {
+        auto &batches = m_level_batches[level];
+        bool evaluated = false;
+
+        for (size_t batch = 0; batch < batches.size(); ++batch) {
+            auto &comp_ids = batches[batch];
+            if (!comp_ids.empty()) {
+                m_batch_functions[batch](this, comp_ids.data(), comp_ids.size());
+                comp_ids.clear();
+                evaluated = true;
+            }
+        }
+
+        if (!evaluated) {
+            continue;
+        }
+
+        for (auto node_id : m_dirty_nodes_write) {
+            // the node can be written again by a later level (or by a component with feedback)
+            m_node_time_dirty_write[node_id] = EPOCH_NONE;
+
+            if (resolve_node(node_id)) {
+                m_levelized_changes.push_back(node_id);
+                // dependents in the acyclic region always have a higher level, the others run later in this step
+                for (auto dep = dependents.row_begin(node_id); dep != dependents.row_end(node_id); ++dep) {
+                    assert(m_component_level[*dep] == LEVEL_NONE || m_component_level[*dep] > level || m_input_changed[*dep] == m_epoch);
+                    mark_component_dirty(*dep);
+                }
+            }
+        }
+        m_dirty_nodes_write.clear();
+    }
 }
 
-void Simulator::run_until_stable(size_t stable_ticks) {
-    bool stop = false;
-    auto remaining = stable_ticks;
+void Simulator::levelize() {
+    auto num_components = m_components.size();
+
+    const auto &dependents = m_topology->m_node_dependents;
+
+    // only the components with a batch function (logic gates and buffers) are combinational
+    auto combinational = [this](uint32_t comp_id) {return m_topology->m_component_batch[comp_id] != BATCH_NONE;};
+
+    // combinational components that use an output of the component as an input
+    CsrArray<uint32_t> successors;
+    std::vector<uint32_t> row;
+
+    for (const auto &comp : m_components) {
+        row.clear();
+        if (combinational(comp.id())) {
+            for (auto idx = 0u; idx < comp.num_outputs(); ++idx) {
+                auto node_id = m_pin_nodes[comp.pin_by_index(comp.output_pin_index(idx))];
+                std::copy_if(dependents.row_begin(node_id), dependents.row_end(node_id),
+                             std::back_inserter(row), combinational);
+            }
+        }
+        successors.append_row(row.begin(), row.end());
+    }
+
+    // strongly connected components (iterative version of Tarjan's algorithm). A component that is part of a
+    //  feedback loop (e.g. a latch) isn't levelized. The scc's are found in reverse topological order.
+    const uint32_t UNVISITED = static_cast<uint32_t>(-1);
+    std::vector<uint32_t> index(num_components, UNVISITED);
+    std::vector<uint32_t> lowlink(num_components, 0);
+    std::vector<bool> on_stack(num_components, false);
+    std::vector<bool> cyclic(num_components, false);
+    std::vector<uint32_t> scc_stack;
+    std::vector<uint32_t> reverse_order;
+    std::vector<std::pair<uint32_t, uint32_t>> call_stack;     // component, next successor to visit
+    uint32_t next_index = 0;
+
+    auto visit = [&](uint32_t comp_id) {
+        index[comp_id] = lowlink[comp_id] = next_index++;
+        scc_stack.push_back(comp_id);
+        on_stack[comp_id] = true;
+        call_stack.push_back({comp_id, 0});
+    };
+
+    for (uint32_t root = 0; root < num_components; ++root) {
+        if (!combinational(root) || index[root] != UNVISITED) {
+            continue;
+        }
+
+        visit(root);
+
+        while (!call_stack.empty()) {
+            auto comp_id = call_stack.back().first;
+            auto &next = call_stack.back().second;
+
+            if (next < successors.row_size(comp_id)) {
+                auto succ = successors.row_begin(comp_id)[next++];
+                if (succ == comp_id) {
+                    cyclic[comp_id] = true;
+                } else if (index[succ] == UNVISITED) {
+                    visit(succ);
+                } else if (on_stack[succ]) {
+                    lowlink[comp_id] = std::min(lowlink[comp_id], index[succ]);
+                }
+                continue;
+            }
+
+            call_stack.pop_back();
+            if (!call_stack.empty()) {
+                auto parent = call_stack.back().first;
+                lowlink[parent] = std::min(lowlink[parent], lowlink[comp_id]);
+            }
+
+            if (lowlink[comp_id] == index[comp_id]) {
+                auto first = std::find(scc_stack.rbegin(), scc_stack.rend(), comp_id).base() - 1;
+                bool loop = std::distance(first, scc_stack.end()) > 1;
+                for (auto member = first; member != scc_stack.end(); ++member) {
+                    on_stack[*member] = false;
+                    cyclic[*member] = cyclic[*member] || loop;
+                    reverse_order.push_back(*member);
+                }
+                scc_stack.erase(first, scc_stack.end());
+            }
+        }
+    }
+
+    // level = length of the longest path from an input of the acyclic region
+    m_component_level.assign(num_components, LEVEL_NONE);
+    uint32_t num_levels = 0;
+
+    for (auto comp_id = reverse_order.rbegin(); comp_id != reverse_order.rend(); ++comp_id) {
+        if (cyclic[*comp_id]) {
+            continue;
+        }
+
+        auto &level = m_component_level[*comp_id];
+        if (level == LEVEL_NONE) {
+            level = 0;
+        }
+        num_levels = std::max(num_levels, level + 1);
+
+        for (auto succ = successors.row_begin(*comp_id); succ != successors.row_end(*comp_id); ++succ) {
+            if (!cyclic[*succ] && (m_component_level[*succ] == LEVEL_NONE || m_component_level[*succ] <= level)) {
+                m_component_level[*succ] = level + 1;
+            }
+        }
+    }
+
+    m_level_batches.assign(num_levels, std::vector<component_ids_t>(m_batch_types.size()));
+    m_levels_valid = true;
+}
+
+void Simulator::run_batches_parallel() {
+    // split the dirty lists into chunks, the worker threads balance the load by stealing chunks from each other
+    m_batch_chunks.clear();
+    for (size_t batch = 0; batch < m_dirty_batches.size(); ++batch) {
+        auto size = m_dirty_batches[batch].size();
+        for (size_t begin = 0; begin < size; begin += PARALLEL_CHUNK_SIZE) {
+            auto end = std::min(size, begin + PARALLEL_CHUNK_SIZE);
+            m_batch_chunks.push_back({static_cast<uint32_t>(batch), static_cast<uint32_t>(begin), static_cast<uint32_t>(end)});
+        }
+    }
+
+    // the components only read the node values of the previous step, their pin writes are deferred
+    m_defer_writes = true;
+    m_step_stats.m_pool = m_workers.run(m_batch_chunks.size(), [this](size_t idx) {
+        const auto &chunk = m_batch_chunks[idx];
+        m_batch_functions[chunk.m_batch](this, m_dirty_batches[chunk.m_batch].data() + chunk.m_begin, chunk.m_end - chunk.m_begin);
+    });
+    m_defer_writes = false;
+
+    // apply the deferred writes in the same order as a single-threaded step
+    for (auto &comp_ids : m_dirty_batches) {
+        for (auto comp_id : comp_ids) {
+            auto pins = component_pins(comp_id);
+            for (auto idx = 0u; idx < component_num_pins(comp_id); ++idx) {
+                if (m_pin_deferred[pins[idx]]) {
+                    m_pin_deferred[pins[idx]] = false;
+                    write_pin(pins[idx], m_deferred_values[pins[idx]]);
+                }
+            }
+        }
+        comp_ids.clear();
+    }
+}
+
+void Simulator::run_until(timestamp_t until) {
+    while (m_time < until) {
+        // fast-forward when nothing is going to change before the next scheduled event
+        //  (nodes written outside of a step are resolved by the next step)
+        if (m_dirty_nodes_read.empty() && m_dirty_nodes_write.empty()) {
+            auto next = std::min({m_scheduled_components.next_time(), m_delayed_writes.next_time(), until});
+            if (next > m_time + 1) {
+                m_time = next - 1;
+            }
+        }
 
-    while (!stop) {
         step();
+    }
+}
 
-        bool stable = std::none_of(std::begin(m_node_change_time), std::end(m_node_change_time), 
-                            [=] (auto t) {return t == m_time;}
-        );
+bool Simulator::run_until_stable(size_t stable_ticks, size_t max_steps) {
+    auto steps = steps_until_stable(stable_ticks, max_steps);
+    return steps != STEPS_NOT_STABLE && steps != STEPS_WATCHPOINT;
+}
+
+size_t Simulator::steps_until_stable(size_t stable_ticks, size_t max_steps) {
+    assert(stable_ticks > 0);
+
+    size_t remaining = stable_ticks;
+    size_t last_change = 0;
+
+    for (size_t steps = 1; steps <= max_steps; ++steps) {
+        step();
+
+        if (watchpoint_hit()) {
+            return STEPS_WATCHPOINT;
+        }
 
-        if (!stable) {
+        if (m_nodes_changed > 0) {
             remaining = stable_ticks;
-        } else {
-            stop = --remaining == 0;
+            last_change = steps;
+        } else if (--remaining == 0) {
+            return last_change;
+        }
+    }
+
+    return STEPS_NOT_STABLE;
+}
+
+size_t Simulator::run(size_t max_steps, const RunCondition &condition) {
+    ConditionMonitor monitor(this, condition);
+    m_last_run_term = TERM_NONE;
+
+    for (size_t steps = 1; steps <= max_steps; ++steps) {
+        step();
+
+        if (condition.empty() && !watchpoint_hit()) {
+            continue;
         }
+
+        if (watchpoint_hit()) {
+            return steps;
+        }
+
+        if (monitor.check(m_levelized_changes) || monitor.check(m_dirty_nodes_read)) {
+            m_last_run_term = monitor.met_term();
+            return steps;
+        }
+    }
+
+    return STEPS_NOT_MET;
+}
+
+uint32_t Simulator::add_watchpoint(node_t node_id, WatchType type, Value value) {
+    assert(node_id < m_node_values_read.size());
+
+    if (m_node_watches.size() != m_node_values_read.size()) {
+        m_node_watches.resize(m_node_values_read.size(), 0);
+    }
+    m_node_watches[node_id] += 1;
+
+    auto current = m_node_values_read[node_id];
+    m_watchpoints.push_back({node_id, type, value, current});
+    return m_watch_id_base + static_cast<uint32_t>(m_watchpoints.size() - 1);
+}
+
+bool Simulator::remove_watchpoint(uint32_t watch_id) {
+    // ids can be stale (e.g. removed twice or from before clear_watchpoints)
+    if (watch_id < m_watch_id_base || watch_id - m_watch_id_base >= m_watchpoints.size()) {
+        return false;
+    }
+
+    // the removed watchpoint stays behind as a tombstone: ids are never reused
+    auto &node_id = m_watchpoints[watch_id - m_watch_id_base].m_node;
+    if (node_id == NODE_INVALID) {
+        return false;
+    }
+    if (node_id < m_node_watches.size()) {
+        m_node_watches[node_id] -= 1;
+    }
+    node_id = NODE_INVALID;
+    return true;
+}
+
+void Simulator::clear_watchpoints() {
+    m_watch_id_base += static_cast<uint32_t>(m_watchpoints.size());
+    m_watchpoints.clear();
+    m_watch_hits.clear();
+    m_node_watches.clear();
+}
+
+void Simulator::check_watchpoints(const node_container_t &changed_nodes) {
+    for (auto node_id : changed_nodes) {
+        if (node_id >= m_node_watches.size() || m_node_watches[node_id] == 0) {
+            continue;
+        }
+
+        auto value = m_node_values_read[node_id];
+
+        for (uint32_t watch_id = 0; watch_id < m_watchpoints.size(); ++watch_id) {
+            auto &watch = m_watchpoints[watch_id];
+            if (watch.m_node != node_id || watch.m_last == value) {
+                continue;
+            }
+
+            auto previous = watch.m_last;
+            watch.m_last = value;
+
+            bool hit = false;
+            switch (watch.m_type) {
+                case WATCH_CHANGE :
+                    hit = true;
+                    break;
+                case WATCH_RISING_EDGE :
+                    hit = previous == VALUE_FALSE && value == VALUE_TRUE;
+                    break;
+                case WATCH_FALLING_EDGE :
+                    hit = previous == VALUE_TRUE && value == VALUE_FALSE;
+                    break;
+                case WATCH_VALUE :
+                    hit = value == watch.m_value;
+                    break;
+            }
+
+            if (hit) {
+                m_watch_hits.push_back({m_watch_id_base + watch_id, node_id, value, m_time});
+            }
+        }
+    }
+}
+
+void Simulator::reset_watchpoints() {
+    // the values of the nodes were reset: only changes after this count. The nodes may have been renumbered
+    //  by finalize, watchpoints on nodes that no longer exist never fire.
+    m_node_watches.assign(m_node_values_read.size(), 0);
+
+    for (auto &watch : m_watchpoints) {
+        if (watch.m_node < m_node_values_read.size()) {
+            m_node_watches[watch.m_node] += 1;
+            watch.m_last = m_node_values_read[watch.m_node];
+        }
+    }
+    m_watch_hits.clear();
+}
+
+void Simulator::add_clock(SimComponent *comp) {
+    assert(comp);
+    assert(comp->description()->type() == COMPONENT_OSCILLATOR ||
+           (comp->description()->type() == COMPONENT_CONNECTOR_IN && comp->user_values_enabled()));
+
+    m_clocks.push_back(comp);
+}
+
+size_t Simulator::run_cycles(size_t num_cycles, size_t max_steps_per_edge) {
+    assert(!m_clocks.empty());
+
+    for (size_t cycle = 0; cycle < num_cycles; ++cycle) {
+        if (!run_clock_edge(VALUE_TRUE, max_steps_per_edge) || !run_clock_edge(VALUE_FALSE, max_steps_per_edge)) {
+            return cycle;
+        }
+    }
+
+    return num_cycles;
+}
+
+bool Simulator::run_clock_edge(Value value, size_t max_steps) {
+    size_t steps = 0;
+
+    // the edge is applied to a stable circuit
+    for (; !m_dirty_nodes_read.empty(); ++steps) {
+        if (steps >= max_steps) {
+            return false;
+        }
+        step();
+    }
+
+    // an edge is a transition of every clock: when a clock already has the value, all clocks go to the opposite
+    //  value first (within the same step budget)
+    if (num_clocks_at(value) > 0) {
+        auto opposite = (value == VALUE_TRUE) ? VALUE_FALSE : VALUE_TRUE;
+        if (!run_clock_level(opposite, max_steps, steps)) {
+            return false;
+        }
+    }
+
+    return run_clock_level(value, max_steps, steps);
+}
+
+bool Simulator::run_clock_level(Value value, size_t max_steps, size_t &steps) {
+    // input connectors change on the next step, oscillators at their next scheduled change
+    for (auto clock : m_clocks) {
+        if (clock->description()->type() == COMPONENT_CONNECTOR_IN) {
+            clock->set_user_value(clock->output_pin_index(0), value);
+        }
+    }
+
+    for (; steps < max_steps; ++steps) {
+        if (m_dirty_nodes_read.empty() && m_dirty_nodes_write.empty()) {
+            if (num_clocks_at(value) == m_clocks.size()) {
+                // all clocks changed and the circuit is stable
+                return true;
+            }
+
+            // skip to the next scheduled event
+            auto next = std::min(m_scheduled_components.next_time(), m_delayed_writes.next_time());
+            if (next == TIMESTAMP_NEVER) {
+                return false;
+            }
+            if (next > m_time + 1) {
+                m_time = next - 1;
+            }
+        }
+
+        step();
     }
+
+    return false;
+}
+
+size_t Simulator::num_clocks_at(Value value) const {
+    return std::count_if(m_clocks.begin(), m_clocks.end(), [this, value](const SimComponent *clock) {
+        return read_pin(clock->pin_by_index(clock->output_pin_index(0))) == value;
+    });
 }
 
 void Simulator::activate_independent_simulation_func(SimComponent *comp) {
@@ -362,44 +1641,187 @@ void Simulator::activate_independent_simulation_func(SimComponent *comp) {
         return;
     }
 
-    auto iter = std::find(m_independent_components.begin(), m_independent_components.end(), comp);
-    if (iter == m_independent_components.end()) {
-        m_independent_components.push_back(comp);
-    }
+    // run the function once, during the next simulation step
+    schedule_independent_simulation_func(comp, m_time + 1);
 }
 
 void Simulator::deactivate_independent_simulation_func(SimComponent *comp) {
 	remove(m_independent_components, comp);
 }
 
-void Simulator::postprocess_dirty_nodes() {
+void Simulator::schedule_independent_simulation_func(SimComponent *comp, timestamp_t when) {
+    assert(comp->id() < m_scheduled_time.size());
+    assert(when > m_time);
 
-    for (auto node_id : m_dirty_nodes_write) {
+    if (m_scheduled_time[comp->id()] != when) {
+        m_scheduled_time[comp->id()] = when;
+        m_scheduled_components.schedule(when, comp->id());
+    }
+}
+
+void Simulator::set_timing_mode(TimingMode mode, uint64_t seed) {
+    m_timing_mode = mode;
+    m_timing_seed = seed;
+}
 
-        switch (m_node_metadata[node_id].m_active_pins.size()) {
-            case 0 :        // no active writers: use default value (i.e. pull-up/down resistor)
-                m_node_values_write[node_id] = m_node_metadata[node_id].m_default;
-                m_node_write_time[node_id] = m_time;
+void Simulator::resolve_propagation_delays() {
+    // xorshift64: the same seed always results in the same set of delays
+    uint64_t rng = m_timing_seed * 0x9e3779b97f4a7c15ull + 1;
+    auto random = [&rng](uint32_t min, uint32_t max) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return min + static_cast<uint32_t>(rng % (max - min + 1));
+    };
+
+    std::vector<uint32_t> rise(m_component_timing.size());
+    std::vector<uint32_t> fall(m_component_timing.size());
+
+    for (size_t idx = 0; idx < m_component_timing.size(); ++idx) {
+        const auto &timing = m_component_timing[idx];
+
+        switch (m_timing_mode) {
+            case TIMING_UNIT_DELAY:
+            case TIMING_LEVELIZED:
+                rise[idx] = fall[idx] = 1;
+                break;
+            case TIMING_MINIMUM:
+            case TIMING_TYPICAL:
+            case TIMING_MAXIMUM:
+                rise[idx] = timing.m_rise[m_timing_mode - TIMING_MINIMUM];
+                fall[idx] = timing.m_fall[m_timing_mode - TIMING_MINIMUM];
                 break;
-            case 1 : {      // normal case - 1 active writer
-                pin_t pin = *m_node_metadata[node_id].m_active_pins.begin();
-                m_node_values_write[node_id] = m_pin_values[pin];
-                m_node_write_time[node_id] = m_time;
+            case TIMING_RANDOM:
+                rise[idx] = random(timing.m_rise[0], timing.m_rise[2]);
+                fall[idx] = random(timing.m_fall[0], timing.m_fall[2]);
                 break;
+        }
+    }
+
+    for (auto &timed : m_timed_pins) {
+        timed.m_delay_rise = rise[timed.m_timing];
+        timed.m_delay_fall = fall[timed.m_timing];
+        timed.m_sequence = 0;
+    }
+
+    m_delays_active = m_timing_mode != TIMING_UNIT_DELAY && m_timing_mode != TIMING_LEVELIZED && !m_timed_pins.empty();
+}
+
+void Simulator::write_pin_delayed(pin_t pin, Value value) {
+    auto &timed = m_timed_pins[m_pin_timed[pin]];
+
+    // a new value supersedes a pending write that hasn't been applied yet (inertial delay)
+    timed.m_sequence += 1;
+
+    if (m_pin_values[pin] == value && m_pin_active[pin] == (value != VALUE_UNDEFINED)) {
+        return;
+    }
+
+    auto delay = (value == VALUE_TRUE) ? timed.m_delay_rise : timed.m_delay_fall;
+    if (delay <= 1) {
+        m_pin_values.set(pin, value);
+        write_node(m_pin_nodes[pin], value, pin);
+        return;
+    }
+
+    // a component that writes in step T with a delay of 1 is visible in step T+1: apply in step T + delay - 1
+    m_delayed_writes.schedule(m_time + delay - 1, {pin, value, timed.m_sequence});
+}
+
+void Simulator::resolve_node_value(node_t node_id) {
+    if (m_topology->m_node_driver[node_id] != PIN_UNDEFINED) {
+        // already resolved by write_node
+        return;
+    }
+
+    switch (m_node_active_pins[node_id]) {
+        case 0 :        // no active writers: use default value (i.e. pull-up/down resistor)
+            m_node_values_write.set(node_id, m_node_defaults[node_id]);
+            break;
+        case 1 : {      // normal case - 1 active writer
+            auto pin = m_topology->m_node_pins.row_begin(node_id);
+            while (!m_pin_active[*pin]) {
+                ++pin;
             }
-            default :       // multiple active writers
-               m_node_values_write[node_id] = VALUE_ERROR;
-               break;
+            m_node_values_write.set(node_id, m_pin_values[*pin]);
+            break;
         }
+        default :       // multiple active writers
+           m_node_values_write.set(node_id, VALUE_ERROR);
+           break;
+    }
+}
 
-        if (m_node_values_read[node_id] != m_node_values_write[node_id]) {
-            m_node_change_time[node_id] = m_time;
-            m_node_values_read[node_id] = m_node_values_write[node_id];
-            m_dirty_nodes_read.push_back(node_id);
+bool Simulator::resolve_node(node_t node_id) {
+    resolve_node_value(node_id);
+
+    auto value = m_node_values_write[node_id];
+    if (m_node_values_read[node_id] == value) {
+        return false;
+    }
+
+    m_node_change_epoch[node_id] = m_epoch;
+    m_node_values_read.set(node_id, value);
+    m_nodes_changed += 1;
+    return true;
+}
+
+void Simulator::renumber_epochs() {
+    // called at the start of a step: the bookkeeping of the previous steps only matters for the change times
+    for (node_t node_id = 0; node_id < m_node_change_epoch.size(); ++node_id) {
+        auto epoch = m_node_change_epoch[node_id];
+        if (epoch != EPOCH_NONE) {
+            m_node_change_time[node_id] = m_epoch_time[epoch];
+            m_node_change_epoch[node_id] = EPOCH_NONE;
         }
     }
 
+    std::fill(std::begin(m_input_changed), std::end(m_input_changed), EPOCH_NONE);
+    std::fill(std::begin(m_node_time_dirty_write), std::end(m_node_time_dirty_write), EPOCH_NONE);
+    m_epoch = 1;
+}
+
+void Simulator::postprocess_dirty_nodes() {
+
+    // a few nodes were written: compare them one by one
+    if (m_dirty_nodes_write.size() < m_node_values_write.num_words()) {
+        for (auto node_id : m_dirty_nodes_write) {
+            if (resolve_node(node_id)) {
+                m_dirty_nodes_read.push_back(node_id);
+            }
+        }
+        m_dirty_nodes_write.clear();
+        return;
+    }
+
+    // a lot of nodes were written: compare the read and write planes 64 nodes at a time
+    //  (outside of a step they only differ for the nodes in m_dirty_nodes_write)
+    for (auto node_id : m_dirty_nodes_write) {
+        resolve_node_value(node_id);
+    }
     m_dirty_nodes_write.clear();
+
+    auto read = m_node_values_read.words();
+    auto write = m_node_values_write.words();
+    auto num_words = m_node_values_write.num_words();
+
+    for (size_t idx = 0; idx < num_words; ++idx) {
+        auto changed = (read[idx].m_bit0 ^ write[idx].m_bit0) | (read[idx].m_bit1 ^ write[idx].m_bit1);
+        if (idx == num_words - 1) {
+            changed &= m_node_values_write.last_word_mask();
+        }
+        if (!changed) {
+            continue;
+        }
+
+        read[idx] = write[idx];
+        for (; changed != 0; changed &= changed - 1) {
+            auto node_id = static_cast<node_t>(idx * 64 + count_trailing_zeros(changed));
+            m_node_change_epoch[node_id] = m_epoch;
+            m_dirty_nodes_read.push_back(node_id);
+            m_nodes_changed += 1;
+        }
+    }
 }
 
-} // namespace lsim
\ No newline at end of file
+} // namespace lsim
@@ -5,29 +5,116 @@
 
 // includes
 #include "sim_component.h"
+#include "sim_condition.h"
 #include "sim_functions.h"
+#include "sim_timing_wheel.h"
+#include "sim_worker_pool.h"
 
 
+#include <cassert>
+#include <deque>
+#include <memory>
 #include <vector>
 #include <array>
 
 namespace lsim {
 
-struct NodeMetadata {
-    using component_set_t = std::set<SimComponent *>;
-    using pin_set_t = std::set<pin_t>;
+// index of the batch function of a component that doesn't have one
+const uint8_t BATCH_NONE = 0xff;
 
-    NodeMetadata() = default;
+// pin that isn't driven by a component with a propagation delay
+const uint32_t TIMED_PIN_NONE = static_cast<uint32_t>(-1);
 
-    // data
-    Value               m_default = VALUE_UNDEFINED;
-    component_set_t     m_dependents;
-	pin_container_t		m_pins;
-    pin_set_t           m_active_pins;
-	timestamp_t			m_time_dirty_write = 0;
+// default minimum number of components with changed inputs before a step is spread over multiple threads
+const size_t PARALLEL_STEP_THRESHOLD = 256;
+
+// number of components handed to a worker thread at once
+const size_t PARALLEL_CHUNK_SIZE = 64;
+
+// which of the propagation delays of the components are used by the simulator
+enum TimingMode {
+    TIMING_UNIT_DELAY = 0,      // every component responds in exactly one step, delays are ignored
+    TIMING_MINIMUM,
+    TIMING_TYPICAL,
+    TIMING_MAXIMUM,
+    TIMING_RANDOM,              // each component gets a random delay between its minimum and maximum
+    TIMING_LEVELIZED,           // acyclic combinational logic settles within one step, feedback loops keep a unit delay
+};
+
+// the per step bookkeeping of nodes and components is stamped with a 16-bit step counter (epoch) instead of a
+//  full timestamp. The epochs are renumbered every EPOCH_PERIOD steps, EPOCH_NONE never matches a step.
+using epoch_t = uint16_t;
+const epoch_t EPOCH_NONE = 0;
+const epoch_t EPOCH_PERIOD = 4096;
+
+// result of steps_until_stable when the budget ran out
+const size_t STEPS_NOT_STABLE = static_cast<size_t>(-1);
+
+// result of steps_until_stable when a watchpoint halted the simulation
+const size_t STEPS_WATCHPOINT = static_cast<size_t>(-2);
+
+// result of run when the condition wasn't met within the step budget
+const size_t STEPS_NOT_MET = static_cast<size_t>(-1);
+
+// maximum number of entries in the log of changed nodes (changes and steps, so steps without changes also count),
+//  older steps are dropped when it's full
+const size_t CHANGE_LOG_LIMIT = 1 << 20;
+
+// component that isn't part of an acyclic combinational region
+const uint32_t LEVEL_NONE = static_cast<uint32_t>(-1);
+
+// optional passes over the netlist, applied by finalize()
+enum NetlistOptimization {
+    OPTIMIZE_NONE = 0,
+    OPTIMIZE_CONSTANTS = 1 << 0,    // fold gates with constant inputs, skip the gates that can't reach an observed pin
+    OPTIMIZE_MERGE_GATES = 1 << 1,  // merge gates of the same type with the same inputs
+    OPTIMIZE_LOOKUP_TABLES = 1 << 2,    // instantiate small combinational sub-circuits as lookup tables
+};
+
+// what the netlist optimizations achieved
+struct NetlistReduction {
+    size_t          m_folded_gates = 0;         // gates with constant inputs, their outputs keep a constant value
+    size_t          m_dead_gates = 0;           // gates that can't affect an observed pin, they are never evaluated
+    size_t          m_merged_gates = 0;         // duplicate gates, their outputs are connected to the original gate
+};
+
+// statistics of the last simulation step, to tune the parallel threshold
+struct StepStats {
+    size_t          m_dirty_components = 0;     // components with a batch function that were evaluated
+    bool            m_parallel = false;         // evaluated by the worker threads or inline
+    WorkerPoolStats m_pool;                     // only valid for parallel steps
+};
+
+// what makes a watchpoint fire when its node changes value
+enum WatchType {
+    WATCH_CHANGE = 0,               // any change
+    WATCH_RISING_EDGE,              // false to true
+    WATCH_FALLING_EDGE,             // true to false
+    WATCH_VALUE,                    // the node changes to the value of the watchpoint
+};
+
+// a watchpoint that fired during the last simulation step
+struct WatchpointHit {
+    uint32_t        m_watch;
+    node_t          m_node;
+    Value           m_value;        // new value of the node
+    timestamp_t     m_time;
+};
+
+// the netlist in the flat form that is used during simulation. finalize() builds it, after that it is never
+//  modified (a change to the netlist results in a new one) so the forks of a simulator can share it.
+struct SimTopology {
+    CsrArray<uint32_t>      m_node_dependents;		// node-id => ids of the components that use the node as an input
+    CsrArray<pin_t>         m_node_pins;			// node-id => pins connected to the node
+    pin_container_t         m_node_driver;			// the only output pin that can drive the node (or PIN_UNDEFINED)
+    std::vector<uint8_t>    m_component_batch;		// index of the batch function of the component (or BATCH_NONE)
+    std::vector<std::pair<node_t, Value>> m_constant_nodes;	// nodes driven by a folded gate, with their value
+    NetlistReduction        m_reduction;
 };
 
 class Simulator {
+    friend class BitParallelSimulator;
+    friend class CompiledSimulator;
 public:
     Simulator() = default;
     Simulator(const Simulator &) = delete;
@@ -35,34 +122,48 @@ public:
     // components
     SimComponent *create_component(ModelComponent *desc);
     void clear_components();
+    size_t num_components() const {return m_components.size();}
+    SimComponent *component_by_id(uint32_t comp_id);
+
+    // arenas for the variable sized data of the components: the offsets stay valid, the pointers only until
+    //  the next allocation
+    uint32_t allocate_user_values(size_t count);
+    Value *user_values(uint32_t offset) {return m_user_values.data() + offset;}
+    uint32_t allocate_extra_data(size_t size);
+    uint8_t *extra_data(uint32_t offset) {return m_extra_data.data() + offset;}
+
+    // truth tables of the lookup table components, shared by all the instances of a circuit
+    uint32_t add_lookup_table(std::shared_ptr<const LookupTable> table);
+    const LookupTable &lookup_table(uint32_t index) const {return *m_lookup_tables[index];}
 
     // pins
-    pin_t assign_pin(SimComponent *component, bool used_as_input);
-    node_t connect_pins(pin_t pin_a, pin_t pin_b);
+    pin_t assign_pin();
+    void connect_pins(pin_t pin_a, pin_t pin_b);
     void clear_pins();
+    size_t num_pins() const {return m_pin_parent.size();}
+    void pin_set_observed(pin_t pin);
     void pin_set_default(pin_t pin, Value value);
     void pin_set_initial_value(pin_t pin, Value value);
-    void write_pin(pin_t pin, Value value);
-    Value read_pin(pin_t pin) const;
+    inline void write_pin(pin_t pin, Value value);
+    inline Value read_pin(pin_t pin) const;
     Value read_pin_current_step(pin_t pin) const;
     bool pin_changed_previous_step(pin_t pin) const;
     timestamp_t pin_last_change_time(pin_t pin) const;
 
     node_t pin_node(pin_t pin) const;
-    Value pin_output_value(pin_t pin) const;
+    inline Value pin_output_value(pin_t pin) const;
+    inline bool pin_stays_undefined(pin_t pin) const;
     void pin_set_output_value(pin_t pin, Value value);
 
-    // nodes
-    node_t assign_node(SimComponent *component, bool used_as_input);
-    void release_node(node_t node_id);
-    node_t merge_nodes(node_t node_a, node_t node_b);
+    // nodes: the pins are only assigned to nodes by finalize(), node ids are dense and never reused
     void clear_nodes();
+    size_t num_nodes() const {return m_node_values_read.size();}
 
     void node_set_default(node_t node_id, Value value);
     void node_set_initial_value(node_t node_id, Value value);
 
-    void write_node(node_t node_id, Value value, pin_t from_pin);
-    Value read_node(node_t node_id) const;
+    inline void write_node(node_t node_id, Value value, pin_t from_pin);
+    inline Value read_node(node_t node_id) const;
     Value read_node_current_step(node_t node_id) const;
 
     bool node_changed_previous_step(node_t node_id) const;
@@ -70,58 +171,387 @@ public:
 
     bool node_dirty(node_t node_id) const;
 
+    // the only pin that can drive the node (or PIN_UNDEFINED), its writes resolve the node right away
+    pin_t node_driver(node_t node_id) const;
+
+    // change tracking: the generation is incremented by every step (and by init). changed_nodes_since() fills
+    //  'changed' with the nodes that changed value after the given generation and returns the current generation.
+    //  The log of changes is only kept after the first call: until then, or when the requested generation
+    //  is too old, all nodes are reported.
+    uint64_t generation() const {return m_generation;}
+    uint64_t changed_nodes_since(uint64_t generation, node_container_t &changed);
+
     // simulation functions
     void register_sim_function(ComponentType comp_type, SimFuncType func_type, simulation_func_t func);
+    void register_batch_function(ComponentType comp_type, simulation_batch_func_t func);
     bool component_has_function(ComponentType comp_type, SimFuncType func_type);
 
+    // flat topology access for batched simulation functions
+    const pin_t *component_pins(uint32_t comp_id) const {return m_component_pins.row_begin(comp_id);}
+    uint32_t component_num_pins(uint32_t comp_id) const {return static_cast<uint32_t>(m_component_pins.row_size(comp_id));}
+
     // simulation
+    void finalize();
     void init();
     void step();
-    void run_until_stable(size_t stable_ticks);
+    void run_until(timestamp_t until);
     timestamp_t current_time() const {return m_time;}
+    size_t nodes_changed_last_step() const {return m_nodes_changed;}
 
+    // run until no node changed value for 'stable_ticks' consecutive steps or until 'max_steps' steps were run.
+    //  run_until_stable returns false when the circuit didn't settle within the budget (e.g. an oscillating circuit),
+    //  steps_until_stable returns the number of steps up to the last change (or STEPS_NOT_STABLE).
+    bool run_until_stable(size_t stable_ticks, size_t max_steps = STEPS_UNLIMITED);
+    size_t steps_until_stable(size_t stable_ticks, size_t max_steps = STEPS_UNLIMITED);
+
+    // run until the condition is met or until 'max_steps' steps were run. The condition is only evaluated for the
+    //  nodes that changed value. Returns the number of steps that were run when the condition was met
+    //  (or STEPS_NOT_MET), last_run_term() is the index of the term that was met.
+    size_t run(size_t max_steps, const RunCondition &condition);
+    size_t last_run_term() const {return m_last_run_term;}
+
+    // watchpoints: checked after each step, only for the watched nodes that changed value (nothing is checked when
+    //  there are no watchpoints). A watchpoint that fires halts run() (returns the number of steps, without a term)
+    //  and run_until_stable() (returns false / STEPS_WATCHPOINT). The hits are reset at the start of each step.
+    //  Ids are never reused, not even after clear_watchpoints.
+    uint32_t add_watchpoint(node_t node_id, WatchType type, Value value = VALUE_TRUE);
+    bool remove_watchpoint(uint32_t watch_id);                 // false for an invalid (e.g. already removed) id
+    void clear_watchpoints();
+    bool watchpoint_hit() const {return !m_watch_hits.empty();}
+    const std::vector<WatchpointHit> &watchpoint_hits() const {return m_watch_hits;}
+
+    // independent simulation functions either run every simulation step (e.g. to sample values) or are
+    //  scheduled to run at a specific timestamp. Steps where nothing happens can be skipped by run_until,
+    //  functions that run every step should use current_time() to account for skipped steps.
     void activate_independent_simulation_func(SimComponent *comp);
     void deactivate_independent_simulation_func(SimComponent *comp);
+    void schedule_independent_simulation_func(SimComponent *comp, timestamp_t when);
+
+    // cycle based simulation: run_cycles toggles the clocks (oscillators or input connectors). After each clock edge
+    //  the circuit runs until it is stable, steps where nothing happens are skipped. A cycle is a rising and a falling
+    //  edge of every clock, when a clock is already high all clocks go low first. Returns the number of completed
+    //  cycles (less than requested when an edge, including going low first, took more than max_steps_per_edge steps).
+    //  Use the TIMING_LEVELIZED mode to settle the combinational logic between the edges in a single step.
+    void add_clock(SimComponent *comp);
+    void clear_clocks() {m_clocks.clear();}
+    size_t run_cycles(size_t num_cycles, size_t max_steps_per_edge = 10000);
+
+    // propagation delays: takes effect on the next call to init()
+    void set_timing_mode(TimingMode mode, uint64_t seed = 0);
+    TimingMode timing_mode() const {return m_timing_mode;}
+
+    // netlist optimizations: take effect on the next call to finalize(). Disabled by default because the nodes that
+    //  are only driven by skipped gates keep their initial value: only observed pins are guaranteed to have the correct
+    //  value. instantiate() marks the connectors of the top level circuit as observed, the pins of components that
+    //  aren't gates or connectors (e.g. leds) are always observed. Nodes driven by a folded gate have their value.
+    //  Merged gates share their output nodes with the gate they duplicate. Lookup tables are created by instantiate().
+    void set_netlist_optimizations(uint32_t flags);
+    uint32_t netlist_optimizations() const {return m_netlist_optimizations;}
+    NetlistReduction netlist_reduction() const;
+
+    // multi-threading: steps with at least 'parallel_threshold' components with changed inputs are spread
+    //  over the worker threads, results are identical to a single-threaded simulation
+    void set_num_threads(size_t num_threads);
+    size_t num_threads() const {return m_num_threads;}
+    void set_parallel_threshold(size_t min_dirty_components) {m_parallel_threshold = min_dirty_components;}
+    size_t parallel_threshold() const {return m_parallel_threshold;}
+    const StepStats &last_step_stats() const {return m_step_stats;}
+
+    // snapshots: a copy of the complete simulation state (values, timestamps, scheduled events and the extra data
+    //  of the components) that can be restored much faster than init() and re-settling the circuit.
+    //  A snapshot can only be restored into the simulator it was taken from, or one of its forks, as long as the
+    //  netlist hasn't changed. restore() refuses other snapshots and returns false.
+    class Snapshot;
+    Snapshot snapshot() const;
+    bool restore(const Snapshot &snapshot);
+
+    // forks: an independent copy of the simulator in its current state. The forks share the frozen netlist and
+    //  can run on separate threads (a fork runs single-threaded). The netlist of a fork can't be changed,
+    //  use SimCircuit::clone() to access the circuits in a fork.
+    std::unique_ptr<Simulator> fork() const;
 
 private:
+    pin_t pin_root(pin_t pin);
+    void build_nodes(SimTopology &topology);
+    void build_node_pins(SimTopology &topology, node_t num_nodes);
+    std::vector<uint32_t> count_node_drivers(node_t num_nodes, const std::vector<bool> &merged,
+                                             pin_container_t *last_driver = nullptr) const;
+    void build_dependents(SimTopology &topology, const std::vector<bool> &reactive);
+    void optimize_constants(SimTopology &topology, std::vector<bool> &reactive, const std::vector<bool> &merged);
+    void merge_gates(SimTopology &topology, std::vector<bool> &reactive, std::vector<bool> &merged);
     void postprocess_dirty_nodes();
+    void write_pin_delayed(pin_t pin, Value value);
+    void resolve_propagation_delays();
+    void run_batches_parallel();
+    bool run_clock_edge(Value value, size_t max_steps);
+    bool run_clock_level(Value value, size_t max_steps, size_t &steps);
+    size_t num_clocks_at(Value value) const;
+    void levelize();
+    void run_levelized();
+    void mark_component_dirty(uint32_t comp_id);
+    void resolve_node_value(node_t node_id);
+    bool resolve_node(node_t node_id);
+    void renumber_epochs();
+    void assign_state(const Snapshot &snapshot);
+    void check_watchpoints(const node_container_t &changed_nodes);
+    void reset_watchpoints();
+    timestamp_t node_change_time(node_t node_id) const;
 
 private:
     using timestamp_container_t = std::vector<timestamp_t>;
-    using component_container_t = std::vector<std::unique_ptr<SimComponent> >;
+    using component_container_t = std::deque<SimComponent>;
     using component_refs_t = std::vector<SimComponent *>;
-    using node_metadata_container_t = std::vector<NodeMetadata>;
     using sim_func_container_t = std::vector<sim_component_functions_t>;
+    using flag_container_t = std::vector<uint8_t>;
+    using epoch_container_t = std::vector<epoch_t>;
+    using count_container_t = std::vector<uint32_t>;
+    using batch_func_container_t = std::vector<simulation_batch_func_t>;
+    using component_ids_t = std::vector<uint32_t>;
+
+    // delays of a component, in simulation steps
+    struct ComponentTiming {
+        uint32_t    m_rise[3];              // min / typ / max
+        uint32_t    m_fall[3];
+    };
+
+    // output pin of a component with a propagation delay
+    struct TimedPin {
+        uint32_t    m_timing;               // index in m_component_timing
+        uint32_t    m_delay_rise;           // delays resolved for the current timing mode
+        uint32_t    m_delay_fall;
+        uint32_t    m_sequence;             // incremented on each write, to cancel superseded pending writes
+    };
+
+    // consecutive components in the dirty list of a batch function
+    struct BatchChunk {
+        uint32_t    m_batch;
+        uint32_t    m_begin;
+        uint32_t    m_end;
+    };
+
+    struct PendingWrite {
+        pin_t       m_pin;
+        Value       m_value;
+        uint32_t    m_sequence;
+    };
 
 private:
     timestamp_t    m_time = 0;								// current simulation timestamp
+    epoch_t        m_epoch = EPOCH_NONE;					// epoch of the current simulation step
+    uint64_t       m_generation = 0;						// number of steps and inits
+    timestamp_container_t m_epoch_time;						// epoch => timestamp of the step
+    bool           m_topology_dirty = false;				// netlist changed since the last call to finalize()
+    bool           m_is_fork = false;						// created by fork(), without the connections between the pins
+    uint32_t       m_netlist_optimizations = OPTIMIZE_NONE;
 
 	// components
-    component_container_t		m_components;				// all simulator components
-	timestamp_container_t		m_input_changed;			// timestamp when component was last added to "to simulate" list
+    component_container_t		m_components;				// all simulator components (stable addresses)
+    CsrArray<pin_t>             m_component_pins;			// component-id => pins of the component
+    value_container_t           m_user_values;				// arena for the user values of the components
+    std::vector<uint8_t>        m_extra_data;				// arena for the extra data of the components
+    std::vector<std::shared_ptr<const LookupTable>> m_lookup_tables;
+	epoch_container_t			m_input_changed;			// epoch when component was last added to "to simulate" list
     component_refs_t            m_init_components;			// components with an init function
-    component_refs_t            m_independent_components;	// components with an input independent update function
-	component_refs_t			m_dirty_components;			// components with changed input values
+    component_refs_t            m_independent_components;	// components with an input independent update function (run every step)
+    component_refs_t            m_clocks;					// clocks for cycle based simulation (the first one is the reference)
+    TimingWheel<uint32_t>       m_scheduled_components;		// components with an independent function scheduled at a specific time
+    timestamp_container_t       m_scheduled_time;			// timestamp the component was last scheduled for
+	component_refs_t			m_dirty_components;			// components with changed input values (without a batch function)
+    std::vector<component_ids_t> m_dirty_batches;			// components with changed input values, bucketed per batch function
+
+    // propagation delays
+    TimingMode                  m_timing_mode = TIMING_UNIT_DELAY;
+    uint64_t                    m_timing_seed = 0;
+    bool                        m_delays_active = false;		// timing mode and delays in effect since the last init()
+    std::vector<ComponentTiming> m_component_timing;		// delays of the components that specify them
+    std::vector<TimedPin>       m_timed_pins;				// output pins of the components with delays
+    count_container_t           m_pin_timed;				// pin => index in m_timed_pins (or TIMED_PIN_NONE)
+    TimingWheel<PendingWrite>   m_delayed_writes;			// writes waiting for the propagation delay to pass
+
+    // levelized evaluation
+    bool                        m_levelized = false;			// TIMING_LEVELIZED in effect since the last init()
+    bool                        m_levels_valid = false;			// levels are up to date with the netlist
+    count_container_t           m_component_level;			// level in an acyclic combinational region (or LEVEL_NONE)
+    std::vector<std::vector<component_ids_t>> m_level_batches;	// components with changed input values, per level and batch function
+
+    // multi-threading
+    size_t                      m_num_threads = 1;
+    size_t                      m_parallel_threshold = PARALLEL_STEP_THRESHOLD;
+    WorkerPool                  m_workers;
+    bool                        m_defer_writes = false;		// store pin writes in m_deferred_values (while the worker threads run)
+    flag_container_t            m_pin_deferred;				// pin has a deferred write
+    value_container_t           m_deferred_values;			// value of the deferred write of the pin
+    std::vector<BatchChunk>     m_batch_chunks;				// units of work for the worker threads
+    StepStats                   m_step_stats;
 
 	// pins
-    node_container_t            m_pin_nodes;				// node assignment for each pin
-    value_container_t           m_pin_values;				// last value written to a pin
+    pin_container_t             m_pin_parent;				// union-find of the connected pins (build-time)
+    std::vector<uint8_t>        m_pin_rank;					// upper bound of the height of the pin's union-find tree
+    node_container_t            m_pin_nodes;				// node assignment for each pin (by finalize)
+    flag_container_t            m_pin_observed;				// pin is read from outside the netlist (build-time)
+    PackedValues                m_pin_values;				// last value written to a pin
+    flag_container_t            m_pin_active;				// pin is actively driving its node (last write wasn't undefined)
 
 	// nodes
-    node_metadata_container_t m_node_metadata;				// assorted metadata
-    node_container_t          m_free_nodes;					// list of node-ids that can be reused
-    value_container_t         m_node_values_read;			// values of the nodes after the last simulation run
-    value_container_t         m_node_values_write;			// values of the nodes in the current simulation run
+    PackedValues              m_node_defaults;				// value of the node when no pin is driving it
+    count_container_t         m_node_active_pins;			// number of pins actively driving the node (not for single driver nodes)
+    epoch_container_t         m_node_time_dirty_write;		// epoch when node was last added to the dirty list
+    PackedValues              m_node_values_read;			// values of the nodes after the last simulation run
+    PackedValues              m_node_values_write;			// values of the nodes in the current simulation run
     node_container_t          m_dirty_nodes_read;			// nodes that were changed in the last simulation run
     node_container_t          m_dirty_nodes_write;			// nodes that were changed in the current simulation run
+    node_container_t          m_levelized_changes;			// nodes changed by the levelized evaluation of the current step
+
+    epoch_container_t         m_node_change_epoch;			// epoch when node last changed value (EPOCH_NONE: see m_node_change_time)
+    timestamp_container_t     m_node_change_time;			// timestamp of changes before the epochs were last renumbered
+    bool                      m_all_nodes_dirty = false;	// all nodes are dirty right after init()
+    size_t                    m_nodes_changed = 0;			// number of nodes that changed value in the last step
+    size_t                    m_last_run_term = TERM_NONE;
 
-    timestamp_container_t     m_node_write_time;			// timestamp when node was last written to
-    timestamp_container_t     m_node_change_time;			// timestamp when node last changed value
+    // change tracking
+    bool                      m_track_changes = false;
+    uint64_t                  m_change_log_start = 0;		// the log holds the changes of the steps after this generation
+    node_container_t          m_change_log;					// nodes changed by the steps in the log, in order
+    std::vector<size_t>       m_change_log_offsets;			// index in m_change_log of the first change of each step
+    flag_container_t          m_node_reported;				// scratch space for changed_nodes_since
+
+    // watchpoints
+    struct Watchpoint {
+        node_t      m_node;                 // NODE_INVALID when the watchpoint was removed
+        WatchType   m_type;
+        Value       m_value;
+        Value       m_last;                 // value of the node at the last check
+    };
+    std::vector<Watchpoint>     m_watchpoints;
+    uint32_t                    m_watch_id_base = 0;		// id of m_watchpoints[0]
+    count_container_t           m_node_watches;				// number of watchpoints on the node
+    std::vector<WatchpointHit>  m_watch_hits;
+
+    // topology (built by finalize)
+    std::shared_ptr<const SimTopology> m_topology;
 
     // simulation functions
     sim_func_container_t        m_sim_functions;
+    batch_func_container_t      m_batch_functions;			// batch functions, in order of registration
+    std::vector<ComponentType>  m_batch_types;				// component type handled by each batch function
 };
 
+// opaque copy of the state of a simulator
+class Simulator::Snapshot {
+    friend class Simulator;
+private:
+    std::shared_ptr<const SimTopology> m_topology;  // netlist the snapshot belongs to
+    timestamp_t                 m_time = 0;
+    epoch_t                     m_epoch = EPOCH_NONE;
+    timestamp_container_t       m_epoch_time;
+
+    epoch_container_t           m_input_changed;
+    component_ids_t             m_independent_components;
+    TimingWheel<uint32_t>       m_scheduled_components;
+    timestamp_container_t       m_scheduled_time;
+
+    bool                        m_delays_active = false;
+    std::vector<TimedPin>       m_timed_pins;
+    TimingWheel<PendingWrite>   m_delayed_writes;
+    bool                        m_levelized = false;
+
+    PackedValues                m_pin_values;
+    flag_container_t            m_pin_active;
+
+    PackedValues                m_node_defaults;
+    count_container_t           m_node_active_pins;
+    epoch_container_t           m_node_time_dirty_write;
+    PackedValues                m_node_values_read;
+    PackedValues                m_node_values_write;
+    node_container_t            m_dirty_nodes_read;
+    node_container_t            m_dirty_nodes_write;
+    epoch_container_t           m_node_change_epoch;
+    timestamp_container_t       m_node_change_time;
+    bool                        m_all_nodes_dirty = false;
+    size_t                      m_nodes_changed = 0;
+
+    value_container_t           m_user_values;
+    std::vector<uint8_t>        m_extra_data;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// inline functions - on the hot path of every simulation step
+//
+
+inline void Simulator::write_pin(pin_t pin, Value value) {
+    assert(pin < m_pin_nodes.size());
+
+    if (m_defer_writes) {
+        // each pin is only written by the component that owns it: no synchronization required
+        m_deferred_values[pin] = value;
+        m_pin_deferred[pin] = true;
+        return;
+    }
+
+    if (m_delays_active && m_pin_timed[pin] != TIMED_PIN_NONE) {
+        write_pin_delayed(pin, value);
+        return;
+    }
+
+    auto node_id = m_pin_nodes[pin];
+    m_pin_values.set(pin, value);
+    write_node(node_id, value, pin);
+}
+
+inline Value Simulator::read_pin(pin_t pin) const {
+    assert(pin < m_pin_nodes.size());
+    return read_node(m_pin_nodes[pin]);
+}
+
+inline Value Simulator::pin_output_value(pin_t pin) const {
+    assert(pin < m_pin_nodes.size());
+    return m_pin_values[pin];
+}
+
+inline bool Simulator::pin_stays_undefined(pin_t pin) const {
+    // a write to a pin with a delay can still supersede a pending write that hasn't been applied yet
+    assert(pin < m_pin_nodes.size());
+    return m_pin_values[pin] == VALUE_UNDEFINED && !(m_delays_active && m_pin_timed[pin] != TIMED_PIN_NONE);
+}
+
+inline void Simulator::write_node(node_t node_id, Value value, pin_t from_pin) {
+    assert(node_id < m_node_values_write.size());
+    assert(from_pin < m_pin_active.size());
+
+	if (m_node_time_dirty_write[node_id] != m_epoch) {
+		m_dirty_nodes_write.push_back(node_id);
+		m_node_time_dirty_write[node_id] = m_epoch;
+	}
+
+    if (m_topology->m_node_driver[node_id] == from_pin) {
+        // the only pin that can drive the node: no contention possible, resolve the node right away
+        m_pin_active[from_pin] = value != VALUE_UNDEFINED;
+        m_node_values_write.set(node_id, (value != VALUE_UNDEFINED) ? value : m_node_defaults[node_id]);
+        return;
+    }
+
+    if (value == VALUE_UNDEFINED) {
+        // pin stops driving the node
+        if (m_pin_active[from_pin]) {
+            m_pin_active[from_pin] = false;
+            m_node_active_pins[node_id] -= 1;
+        }
+        return;
+    }
+
+    m_node_values_write.set(node_id, value);
+    if (!m_pin_active[from_pin]) {
+        m_pin_active[from_pin] = true;
+        m_node_active_pins[node_id] += 1;
+    }
+}
+
+inline Value Simulator::read_node(node_t node_id) const {
+    assert(node_id < m_node_values_read.size());
+    return m_node_values_read[node_id];
+}
+
 } // namespace lsim
 
 #endif // LSIM_SIMULATOR_H
\ No newline at end of file
@@ -51,9 +51,7 @@ int main() {
 
     std::printf("+++ running simulation for %d cycles\n", CYCLE_COUNT);
     chrono_reset();
-    for (int i = 0; i < CYCLE_COUNT; ++i) {
-        lsim_context.sim()->step();
-    }
+    lsim_context.sim()->run(CYCLE_COUNT, lsim::RunCondition());
     double duration = chrono_report();
     std::printf("+++ done (%f seconds): %.2f Hz (%.2f kHz)\n", duration, CYCLE_COUNT / duration, CYCLE_COUNT / (duration * 1000));
 
@@ -283,4 +283,319 @@ TEST_CASE("8bit adder (multi-level cloning)", "[circuit]") {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Circuit templates", "[circuit]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    // a cell that inverts its input, used 4 times in a register and the register is used twice
+    auto cell_desc = lsim_context.create_user_circuit("cell");
+    auto c_in = cell_desc->add_connector_in("in", 1);
+    auto c_out = cell_desc->add_connector_out("out", 1);
+    auto c_not = cell_desc->add_not_gate();
+    cell_desc->connect(c_in->pin_id(0), c_not->pin_id(0));
+    cell_desc->connect(c_not->pin_id(1), c_out->pin_id(0));
+
+    auto reg_desc = lsim_context.create_user_circuit("register");
+    auto r_in = reg_desc->add_connector_in("in", 4);
+    auto r_out = reg_desc->add_connector_out("out", 4);
+    for (uint32_t bit = 0; bit < 4; ++bit) {
+        auto cell = reg_desc->add_sub_circuit("cell");
+        reg_desc->connect(r_in->pin_id(bit), cell->port_by_name("in"));
+        reg_desc->connect(cell->port_by_name("out"), r_out->pin_id(bit));
+    }
+
+    auto main_desc = lsim_context.create_user_circuit("main");
+    auto in = main_desc->add_connector_in("in", 4);
+    auto out = main_desc->add_connector_out("out", 4);
+    auto reg_a = main_desc->add_sub_circuit("register");
+    auto reg_b = main_desc->add_sub_circuit("register");
+    for (uint32_t bit = 0; bit < 4; ++bit) {
+        main_desc->connect(in->pin_id(bit), reg_a->port_by_name(("in[" + std::to_string(bit) + "]").c_str()));
+        main_desc->connect(reg_a->port_by_name(("out[" + std::to_string(bit) + "]").c_str()),
+                           reg_b->port_by_name(("in[" + std::to_string(bit) + "]").c_str()));
+        main_desc->connect(reg_b->port_by_name(("out[" + std::to_string(bit) + "]").c_str()), out->pin_id(bit));
+    }
+
+    // the template is built once and includes the nested circuits
+    const auto *flat = &main_desc->flattened();
+    REQUIRE(flat->num_components() == 4 + 2 * (2 + 4 * (1 + 3)));
+    REQUIRE(flat->instances().size() == 1 + 2 * (1 + 4));
+    REQUIRE(&main_desc->flattened() == flat);
+
+    auto circuit = main_desc->instantiate(sim);
+    REQUIRE(circuit);
+    REQUIRE(sim->num_components() == flat->num_components());
+
+    auto nested = circuit->component_by_id(reg_b->id())->nested_instance();
+    REQUIRE(nested);
+    REQUIRE(nested->description() == reg_desc);
+    REQUIRE(std::string(nested->name()) == "register#" + std::to_string(reg_b->id()));
+
+    sim->init();
+    for (uint64_t value = 0; value < 16; ++value) {
+        circuit->write_output_pins(in->id(), value);
+        sim->run_until_stable(5);
+        REQUIRE(circuit->read_nibble(out->id()) == value);
+    }
+
+    // a second instance reuses the template
+    auto circuit_2 = main_desc->instantiate(sim);
+    REQUIRE(circuit_2);
+    REQUIRE(&main_desc->flattened() == flat);
+    REQUIRE(sim->num_components() == 2 * flat->num_components());
+
+    // changing a nested circuit invalidates the template
+    auto c_buf = cell_desc->add_buffer(1);
+    cell_desc->disconnect_pin(c_out->pin_id(0));
+    cell_desc->connect(c_not->pin_id(1), c_buf->pin_id(0));
+    cell_desc->connect(c_buf->pin_id(1), c_out->pin_id(0));
+    REQUIRE(main_desc->flattened().num_components() == 4 + 2 * (2 + 4 * (1 + 4)));
+
+    sim->clear_components();
+    auto circuit_3 = main_desc->instantiate(sim);
+    REQUIRE(circuit_3);
+    sim->init();
+    for (uint64_t value = 0; value < 16; ++value) {
+        circuit_3->write_output_pins(in->id(), value);
+        sim->run_until_stable(5);
+        REQUIRE(circuit_3->read_nibble(out->id()) == value);
+    }
+}
+
+TEST_CASE("Lookup tables", "[circuit]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    // full adder
+    auto adder_desc = lsim_context.create_user_circuit("adder");
+    auto a_in = adder_desc->add_connector_in("a", 1);
+    auto b_in = adder_desc->add_connector_in("b", 1);
+    auto ci_in = adder_desc->add_connector_in("ci", 1);
+    auto s_out = adder_desc->add_connector_out("s", 1);
+    auto co_out = adder_desc->add_connector_out("co", 1);
+    auto xor_ab = adder_desc->add_xor_gate();
+    auto xor_s = adder_desc->add_xor_gate();
+    auto and_ab = adder_desc->add_and_gate(2);
+    auto and_c = adder_desc->add_and_gate(2);
+    auto or_co = adder_desc->add_or_gate(2);
+    adder_desc->connect(a_in->pin_id(0), xor_ab->pin_id(0));
+    adder_desc->connect(b_in->pin_id(0), xor_ab->pin_id(1));
+    adder_desc->connect(xor_ab->pin_id(2), xor_s->pin_id(0));
+    adder_desc->connect(ci_in->pin_id(0), xor_s->pin_id(1));
+    adder_desc->connect(xor_s->pin_id(2), s_out->pin_id(0));
+    adder_desc->connect(a_in->pin_id(0), and_ab->pin_id(0));
+    adder_desc->connect(b_in->pin_id(0), and_ab->pin_id(1));
+    adder_desc->connect(xor_ab->pin_id(2), and_c->pin_id(0));
+    adder_desc->connect(ci_in->pin_id(0), and_c->pin_id(1));
+    adder_desc->connect(and_ab->pin_id(2), or_co->pin_id(0));
+    adder_desc->connect(and_c->pin_id(2), or_co->pin_id(1));
+    adder_desc->connect(or_co->pin_id(2), co_out->pin_id(0));
+
+    // 4-bit ripple carry adder
+    auto main_desc = lsim_context.create_user_circuit("main");
+    auto in = main_desc->add_connector_in("in", 9);
+    auto out = main_desc->add_connector_out("out", 5);
+    std::vector<ModelComponent *> adders;
+    for (uint32_t bit = 0; bit < 4; ++bit) {
+        auto adder = main_desc->add_sub_circuit("adder");
+        main_desc->connect(in->pin_id(bit), adder->port_by_name("a"));
+        main_desc->connect(in->pin_id(bit + 4), adder->port_by_name("b"));
+        main_desc->connect((bit == 0) ? in->pin_id(8) : adders.back()->port_by_name("co"), adder->port_by_name("ci"));
+        main_desc->connect(adder->port_by_name("s"), out->pin_id(bit));
+        adders.push_back(adder);
+    }
+    main_desc->connect(adders.back()->port_by_name("co"), out->pin_id(4));
+
+    // the truth table is only built once
+    auto table = adder_desc->lookup_table();
+    REQUIRE(table);
+    REQUIRE(adder_desc->lookup_table() == table);
+    REQUIRE(table->table().m_num_inputs == 3);
+    REQUIRE(table->table().m_num_outputs == 2);
+
+    auto s_idx = (adder_desc->port_name(false, 0) == "s") ? 0 : 1;
+    for (uint32_t entry = 0; entry < 8; ++entry) {
+        auto ones = (entry & 1) + ((entry >> 1) & 1) + ((entry >> 2) & 1);
+        REQUIRE(table->table().m_values[entry * 2 + s_idx] == static_cast<Value>(ones & 1));
+        REQUIRE(table->table().m_values[entry * 2 + 1 - s_idx] == static_cast<Value>(ones >= 2));
+    }
+
+    // circuits with feedback loops, too many inputs or other components don't qualify
+    auto latch_desc = lsim_context.create_user_circuit("latch");
+    auto l_in = latch_desc->add_connector_in("in", 2);
+    auto l_out = latch_desc->add_connector_out("out", 1);
+    auto nor_q = latch_desc->add_nor_gate(2);
+    auto nor_nq = latch_desc->add_nor_gate(2);
+    latch_desc->connect(l_in->pin_id(0), nor_q->pin_id(0));
+    latch_desc->connect(nor_nq->pin_id(2), nor_q->pin_id(1));
+    latch_desc->connect(l_in->pin_id(1), nor_nq->pin_id(0));
+    latch_desc->connect(nor_q->pin_id(2), nor_nq->pin_id(1));
+    latch_desc->connect(nor_q->pin_id(2), l_out->pin_id(0));
+    REQUIRE(latch_desc->lookup_table() == nullptr);
+
+    auto wide_desc = lsim_context.create_user_circuit("wide");
+    auto w_in = wide_desc->add_connector_in("in", LOOKUP_TABLE_MAX_INPUTS + 1);
+    auto w_out = wide_desc->add_connector_out("out", 1);
+    auto w_and = wide_desc->add_and_gate(LOOKUP_TABLE_MAX_INPUTS + 1);
+    for (uint32_t bit = 0; bit <= LOOKUP_TABLE_MAX_INPUTS; ++bit) {
+        wide_desc->connect(w_in->pin_id(bit), w_and->pin_id(bit));
+    }
+    wide_desc->connect(w_and->pin_id(LOOKUP_TABLE_MAX_INPUTS + 1), w_out->pin_id(0));
+    REQUIRE(wide_desc->lookup_table() == nullptr);
+
+    auto tristate_desc = lsim_context.create_user_circuit("tristate");
+    auto t_in = tristate_desc->add_connector_in("in", 2);
+    auto t_out = tristate_desc->add_connector_out("out", 1);
+    auto t_buf = tristate_desc->add_tristate_buffer(1);
+    tristate_desc->connect(t_in->pin_id(0), t_buf->pin_id(0));
+    tristate_desc->connect(t_in->pin_id(1), t_buf->pin_id(2));
+    tristate_desc->connect(t_buf->pin_id(1), t_out->pin_id(0));
+    REQUIRE(tristate_desc->lookup_table() == nullptr);
+
+    // the sub-circuits are replaced by lookup table components
+    sim->set_netlist_optimizations(OPTIMIZE_LOOKUP_TABLES);
+    auto circuit = main_desc->instantiate(sim);
+    REQUIRE(circuit);
+    REQUIRE(sim->num_components() == 2 + 4);
+    REQUIRE(circuit->component_by_id(adders[0]->id())->description()->type() == COMPONENT_LOOKUP_TABLE);
+    REQUIRE(circuit->component_by_id(adders[0]->id())->nested_instance() == nullptr);
+
+    sim->init();
+    for (uint64_t data = 0; data < 512; ++data) {
+        circuit->write_output_pins(in->id(), data);
+        REQUIRE(sim->run_until_stable(2));
+
+        auto expected = (data & 0xf) + ((data >> 4) & 0xf) + (data >> 8);
+        for (uint32_t bit = 0; bit < 5; ++bit) {
+            REQUIRE(circuit->read_pin(out->pin_id(bit)) == static_cast<Value>((expected >> bit) & 1));
+        }
+    }
+
+    // an input without a boolean value
+    circuit->write_output_pins(in->id(), VALUE_UNDEFINED);
+    REQUIRE(sim->run_until_stable(2));
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_ERROR);
+}
+
+TEST_CASE("Lookup tables with invalid inputs", "[circuit]") {
+
+    // two independent inverters and a gate that uses both inputs
+    auto build = [](LSimContext &context) {
+        auto two_desc = context.create_user_circuit("two");
+        auto a = two_desc->add_connector_in("a", 1);
+        auto b = two_desc->add_connector_in("b", 1);
+        auto oa = two_desc->add_connector_out("oa", 1);
+        auto ob = two_desc->add_connector_out("ob", 1);
+        auto oab = two_desc->add_connector_out("oab", 1);
+        auto not_a = two_desc->add_not_gate();
+        auto not_b = two_desc->add_not_gate();
+        auto and_ab = two_desc->add_and_gate(2);
+        two_desc->connect(a->pin_id(0), not_a->pin_id(0));
+        two_desc->connect(b->pin_id(0), not_b->pin_id(0));
+        two_desc->connect(a->pin_id(0), and_ab->pin_id(0));
+        two_desc->connect(b->pin_id(0), and_ab->pin_id(1));
+        two_desc->connect(not_a->pin_id(1), oa->pin_id(0));
+        two_desc->connect(not_b->pin_id(1), ob->pin_id(0));
+        two_desc->connect(and_ab->pin_id(2), oab->pin_id(0));
+
+        auto main_desc = context.create_user_circuit("main");
+        auto in = main_desc->add_connector_in("in", 2);
+        auto out = main_desc->add_connector_out("out", 3);
+        auto two = main_desc->add_sub_circuit("two");
+        main_desc->connect(in->pin_id(0), two->port_by_name("a"));
+        main_desc->connect(in->pin_id(1), two->port_by_name("b"));
+        main_desc->connect(two->port_by_name("oa"), out->pin_id(0));
+        main_desc->connect(two->port_by_name("ob"), out->pin_id(1));
+        main_desc->connect(two->port_by_name("oab"), out->pin_id(2));
+        return std::make_pair(in, out);
+    };
+
+    LSimContext gate_context;
+    auto gate_ports = build(gate_context);
+    auto gate_circuit = gate_context.user_library()->circuit_by_name("main")->instantiate(gate_context.sim());
+    REQUIRE(gate_circuit);
+
+    LSimContext lut_context;
+    auto lut_ports = build(lut_context);
+    lut_context.sim()->set_netlist_optimizations(OPTIMIZE_LOOKUP_TABLES);
+    auto lut_circuit = lut_context.user_library()->circuit_by_name("main")->instantiate(lut_context.sim());
+    REQUIRE(lut_circuit);
+
+    auto table = lut_context.user_library()->circuit_by_name("two")->lookup_table();
+    REQUIRE(table);
+    REQUIRE(table->table().m_dependencies.size() == 3);
+
+    gate_context.sim()->init();
+    lut_context.sim()->init();
+
+    // the outputs that don't depend on an invalid input keep their value, the others are an error
+    const Value values[] = {VALUE_FALSE, VALUE_TRUE, VALUE_ERROR};
+    for (auto a : values) {
+        for (auto b : values) {
+            gate_circuit->write_pin(gate_ports.first->pin_id(0), a);
+            gate_circuit->write_pin(gate_ports.first->pin_id(1), b);
+            REQUIRE(gate_context.sim()->run_until_stable(2));
+            lut_circuit->write_pin(lut_ports.first->pin_id(0), a);
+            lut_circuit->write_pin(lut_ports.first->pin_id(1), b);
+            REQUIRE(lut_context.sim()->run_until_stable(2));
+
+            for (auto bit = 0u; bit < 3; ++bit) {
+                REQUIRE(lut_circuit->read_pin(lut_ports.second->pin_id(bit)) ==
+                        gate_circuit->read_pin(gate_ports.second->pin_id(bit)));
+            }
+            REQUIRE(lut_circuit->read_pin(lut_ports.second->pin_id(0)) ==
+                    ((a == VALUE_ERROR) ? VALUE_ERROR : static_cast<Value>(a ^ 1)));
+        }
+    }
+}
+
+TEST_CASE("Lookup tables follow property changes", "[circuit]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    // a gate with one of its inputs tied to a constant
+    auto gate_desc = lsim_context.create_user_circuit("gate");
+    auto g_in = gate_desc->add_connector_in("in", 1);
+    auto g_out = gate_desc->add_connector_out("out", 1);
+    auto g_const = gate_desc->add_constant(VALUE_FALSE);
+    auto g_xor = gate_desc->add_xor_gate();
+    gate_desc->connect(g_in->pin_id(0), g_xor->pin_id(0));
+    gate_desc->connect(g_const->pin_id(0), g_xor->pin_id(1));
+    gate_desc->connect(g_xor->pin_id(2), g_out->pin_id(0));
+
+    auto main_desc = lsim_context.create_user_circuit("main");
+    auto in = main_desc->add_connector_in("in", 1);
+    auto out = main_desc->add_connector_out("out", 1);
+    auto gate = main_desc->add_sub_circuit("gate");
+    main_desc->connect(in->pin_id(0), gate->port_by_name("in"));
+    main_desc->connect(gate->port_by_name("out"), out->pin_id(0));
+
+    sim->set_netlist_optimizations(OPTIMIZE_LOOKUP_TABLES);
+
+    auto check = [&](bool inverted) {
+        sim->clear_components();
+        auto circuit = main_desc->instantiate(sim);
+        REQUIRE(circuit);
+        REQUIRE(circuit->component_by_id(gate->id())->description()->type() == COMPONENT_LOOKUP_TABLE);
+
+        sim->init();
+        for (auto value : {VALUE_FALSE, VALUE_TRUE}) {
+            circuit->write_pin(in->pin_id(0), value);
+            REQUIRE(sim->run_until_stable(2));
+            REQUIRE(circuit->read_pin(out->pin_id(0)) == static_cast<Value>(value ^ inverted));
+        }
+    };
+
+    check(false);
+
+    // editing the value of the constant builds a new truth table
+    auto table = gate_desc->lookup_table();
+    g_const->property("value")->value(VALUE_TRUE);
+    REQUIRE(gate_desc->lookup_table() != table);
+    check(true);
+}
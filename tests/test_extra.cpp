@@ -189,4 +189,74 @@ TEST_CASE("Oscillator Long", "[extra]") {
             sim->step();
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Oscillator run_until", "[extra]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    // a long period that doesn't fit in the timing wheel and a short one that does
+    auto clock_slow = circuit_desc->add_oscillator(1000, 500);
+    auto clock_fast = circuit_desc->add_oscillator(7, 3);
+    auto out_slow = circuit_desc->add_connector_out("slow", 1);
+    auto out_fast = circuit_desc->add_connector_out("fast", 1);
+    auto not_gate = circuit_desc->add_not_gate();
+
+    circuit_desc->connect(clock_slow->output_pin_id(0), not_gate->input_pin_id(0));
+    circuit_desc->connect(not_gate->output_pin_id(0), out_slow->pin_id(0));
+    circuit_desc->connect(clock_fast->output_pin_id(0), out_fast->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    sim->init();
+
+    auto expected = [](timestamp_t t, timestamp_t low, timestamp_t high) {
+        return ((t - 1) % (low + high)) < low ? VALUE_FALSE : VALUE_TRUE;
+    };
+
+    for (timestamp_t t = 100; t < 10000; t += 333) {
+        sim->run_until(t);
+        REQUIRE(sim->current_time() == t);
+        REQUIRE(circuit->read_pin(out_fast->pin_id(0)) == expected(t, 7, 3));
+        // the not-gate takes one step to respond
+        auto slow = expected(t - 1, 1000, 500);
+        REQUIRE(circuit->read_pin(out_slow->pin_id(0)) == (slow == VALUE_TRUE ? VALUE_FALSE : VALUE_TRUE));
+    }
+}
+
+TEST_CASE("Direct writes with run_until", "[extra]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto not_gate = circuit_desc->add_not_gate();
+    auto out = circuit_desc->add_connector_out("out", 1);
+    circuit_desc->connect(not_gate->output_pin_id(0), out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    sim->init();
+    sim->run_until_stable(5);
+
+    // a write outside of a step is resolved by the next step, run_until doesn't skip over it
+    auto pin_in = circuit->pin_from_pin_id(not_gate->input_pin_id(0));
+    auto pin_out = circuit->pin_from_pin_id(not_gate->output_pin_id(0));
+    auto now = sim->current_time();
+    auto value = sim->read_pin(pin_out) == VALUE_TRUE ? VALUE_TRUE : VALUE_FALSE;
+
+    sim->write_pin(pin_in, value);
+    sim->run_until(now + 100);
+    REQUIRE(sim->current_time() == now + 100);
+    REQUIRE(sim->pin_last_change_time(pin_in) == now + 1);
+    // the not-gate takes one step to respond
+    REQUIRE(sim->pin_last_change_time(pin_out) == now + 2);
+}
@@ -0,0 +1,1801 @@
+#include "catch.hpp"
+#include "lsim_context.h"
+#include "sim_circuit.h"
+#include "sim_bit_parallel.h"
+#include "sim_compiled.h"
+
+#include <cstdlib>
+#include <string>
+
+#ifndef _WIN32
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace lsim;
+
+TEST_CASE("Netlist is frozen after instantiation", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 2);
+    auto out = circuit_desc->add_connector_out("out", 1);
+    auto and_gate = circuit_desc->add_and_gate(2);
+    circuit_desc->connect(in->pin_id(0), and_gate->pin_id(0));
+    circuit_desc->connect(in->pin_id(1), and_gate->pin_id(1));
+    circuit_desc->connect(and_gate->pin_id(2), out->pin_id(0));
+
+    // two top-level instances in the same simulator
+    auto circuit_a = circuit_desc->instantiate(sim);
+    auto circuit_b = circuit_desc->instantiate(sim);
+    REQUIRE(circuit_a);
+    REQUIRE(circuit_b);
+
+    sim->init();
+
+    circuit_a->write_output_pins(in->id(), 3);
+    circuit_b->write_output_pins(in->id(), 1);
+    sim->run_until_stable(5);
+    REQUIRE(circuit_a->read_pin(out->pin_id(0)) == VALUE_TRUE);
+    REQUIRE(circuit_b->read_pin(out->pin_id(0)) == VALUE_FALSE);
+
+    // rebuild the netlist from scratch
+    sim->clear_components();
+    auto circuit_c = circuit_desc->instantiate(sim);
+    REQUIRE(circuit_c);
+
+    sim->init();
+
+    circuit_c->write_output_pins(in->id(), 3);
+    sim->run_until_stable(5);
+    REQUIRE(circuit_c->read_pin(out->pin_id(0)) == VALUE_TRUE);
+}
+
+TEST_CASE("Dense node ids", "[simulator]") {
+
+    const int NUM_CELLS = 40;
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    // an inverter in a sub-circuit, with a buffer on the same input
+    auto cell_desc = lsim_context.create_user_circuit("cell");
+    auto c_in = cell_desc->add_connector_in("in", 1);
+    auto c_out = cell_desc->add_connector_out("out", 1);
+    auto c_not = cell_desc->add_not_gate();
+    auto c_buf = cell_desc->add_buffer(1);
+    cell_desc->connect(c_in->pin_id(0), c_not->pin_id(0));
+    cell_desc->connect(c_in->pin_id(0), c_buf->pin_id(0));
+    cell_desc->connect(c_not->pin_id(1), c_out->pin_id(0));
+
+    // a chain of cells: merges nodes across every level of the hierarchy
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto out = circuit_desc->add_connector_out("out", 1);
+
+    auto prev = in->pin_id(0);
+    for (int idx = 0; idx < NUM_CELLS; ++idx) {
+        auto cell = circuit_desc->add_sub_circuit("cell");
+        circuit_desc->connect(prev, cell->port_by_name("in"));
+        prev = cell->port_by_name("out");
+    }
+    circuit_desc->connect(prev, out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    // every node id is used by at least one pin
+    std::vector<bool> used(sim->num_nodes(), false);
+    for (uint32_t comp_id = 0; comp_id < sim->num_components(); ++comp_id) {
+        auto pins = sim->component_pins(comp_id);
+        for (uint32_t idx = 0; idx < sim->component_num_pins(comp_id); ++idx) {
+            auto node_id = sim->pin_node(pins[idx]);
+            REQUIRE(node_id < sim->num_nodes());
+            used[node_id] = true;
+        }
+    }
+    REQUIRE(std::count(used.begin(), used.end(), false) == 0);
+
+    // the nodes in front of, between and after the cells + the output of the buffer in each cell
+    REQUIRE(sim->num_nodes() == 2 * NUM_CELLS + 1);
+
+    sim->init();
+    circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+    sim->run_until_stable(5);
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+    circuit->write_pin(in->pin_id(0), VALUE_FALSE);
+    sim->run_until_stable(5);
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+}
+
+TEST_CASE("Single driver nodes across sub-circuits", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto inv_desc = lsim_context.create_user_circuit("inv");
+    auto i_in = inv_desc->add_connector_in("in", 1);
+    auto i_out = inv_desc->add_connector_out("out", 1);
+    auto i_not = inv_desc->add_not_gate();
+    inv_desc->connect(i_in->pin_id(0), i_not->pin_id(0));
+    inv_desc->connect(i_not->pin_id(1), i_out->pin_id(0));
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto out = circuit_desc->add_connector_out("out", 1);
+    auto inv = circuit_desc->add_sub_circuit("inv");
+    circuit_desc->connect(in->pin_id(0), inv->port_by_name("in"));
+    circuit_desc->connect(inv->port_by_name("out"), out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    // the ports of the sub-circuit and the connectors of the nested circuit don't drive the nodes
+    auto nested = circuit->component_by_id(inv->id())->nested_instance();
+    REQUIRE(nested);
+    REQUIRE(sim->node_driver(circuit->pin_node(in->pin_id(0))) == circuit->pin_from_pin_id(in->pin_id(0)));
+    REQUIRE(sim->node_driver(circuit->pin_node(out->pin_id(0))) == nested->pin_from_pin_id(i_not->pin_id(1)));
+
+    sim->init();
+    circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+    REQUIRE(sim->run_until_stable(2));
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+    circuit->write_pin(in->pin_id(0), VALUE_FALSE);
+    REQUIRE(sim->run_until_stable(2));
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+}
+
+TEST_CASE("Packed value storage", "[simulator]") {
+    PackedValues values;
+    const Value pattern[] = {VALUE_FALSE, VALUE_TRUE, VALUE_UNDEFINED, VALUE_ERROR, VALUE_TRUE};
+
+    for (size_t idx = 0; idx < 130; ++idx) {
+        values.push_back(pattern[idx % 5]);
+    }
+    REQUIRE(values.size() == 130);
+    REQUIRE(values.num_words() == 3);
+    REQUIRE(values.last_word_mask() == 3);
+
+    for (size_t idx = 0; idx < 130; ++idx) {
+        REQUIRE(values[idx] == pattern[idx % 5]);
+    }
+
+    values.set(64, VALUE_ERROR);
+    values.set(65, VALUE_FALSE);
+    REQUIRE(values[63] == pattern[63 % 5]);
+    REQUIRE(values[64] == VALUE_ERROR);
+    REQUIRE(values[65] == VALUE_FALSE);
+    REQUIRE(values[66] == pattern[66 % 5]);
+
+    values.fill(VALUE_UNDEFINED);
+    for (size_t idx = 0; idx < 130; ++idx) {
+        REQUIRE(values[idx] == VALUE_UNDEFINED);
+    }
+}
+
+TEST_CASE("Change times survive the renumbering of the epochs", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto osc = circuit_desc->add_oscillator(1500, 1500);
+    auto not_gate = circuit_desc->add_not_gate();
+    auto out = circuit_desc->add_connector_out("out", 2);
+    circuit_desc->connect(osc->pin_id(0), not_gate->pin_id(0));
+    circuit_desc->connect(not_gate->pin_id(1), out->pin_id(0));
+    circuit_desc->connect(in->pin_id(0), out->pin_id(1));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+    sim->init();
+
+    auto pin_not = circuit->pin_from_pin_id(out->pin_id(0));
+    auto pin_in = circuit->pin_from_pin_id(out->pin_id(1));
+
+    circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+    sim->step();
+    sim->step();
+    auto in_change_time = sim->pin_last_change_time(pin_in);
+    REQUIRE(in_change_time == sim->current_time() - 1);
+
+    auto last_value = sim->read_pin(pin_not);
+    auto last_change = sim->pin_last_change_time(pin_not);
+
+    for (size_t step = 0; step < 3 * EPOCH_PERIOD; ++step) {
+        sim->step();
+
+        auto value = sim->read_pin(pin_not);
+        if (value != last_value) {
+            last_value = value;
+            last_change = sim->current_time();
+        }
+        REQUIRE(sim->pin_last_change_time(pin_not) == last_change);
+        REQUIRE(sim->pin_changed_previous_step(pin_not) == (last_change == sim->current_time() - 1));
+        REQUIRE(sim->pin_last_change_time(pin_in) == in_change_time);
+    }
+}
+
+TEST_CASE("Change tracking", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 2);
+    auto out = circuit_desc->add_connector_out("out", 2);
+    auto not_a = circuit_desc->add_not_gate();
+    auto not_b = circuit_desc->add_not_gate();
+    circuit_desc->connect(in->pin_id(0), not_a->pin_id(0));
+    circuit_desc->connect(not_a->pin_id(1), out->pin_id(0));
+    circuit_desc->connect(in->pin_id(1), not_b->pin_id(0));
+    circuit_desc->connect(not_b->pin_id(1), out->pin_id(1));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+    sim->init();
+    sim->run_until_stable(2);
+
+    auto node_in_a = circuit->pin_node(in->pin_id(0));
+    auto node_out_a = circuit->pin_node(out->pin_id(0));
+    auto node_out_b = circuit->pin_node(out->pin_id(1));
+
+    node_container_t changed;
+    auto contains = [&](node_t node_id) {
+        return std::find(std::begin(changed), std::end(changed), node_id) != std::end(changed);
+    };
+
+    // the first query reports all the nodes
+    auto generation = sim->changed_nodes_since(0, changed);
+    REQUIRE(generation == sim->generation());
+    REQUIRE(contains(node_in_a));
+    REQUIRE(contains(node_out_a));
+    REQUIRE(contains(node_out_b));
+
+    // nothing happened since
+    REQUIRE(sim->changed_nodes_since(generation, changed) == generation);
+    REQUIRE(changed.empty());
+
+    // input a changes in the first step, output a in the second
+    circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+    sim->step();
+    REQUIRE(sim->node_dirty(node_in_a));
+    REQUIRE(!sim->node_dirty(node_out_a));
+    sim->step();
+    REQUIRE(!sim->node_dirty(node_in_a));
+    REQUIRE(sim->node_dirty(node_out_a));
+    sim->step();
+
+    auto next = sim->changed_nodes_since(generation, changed);
+    REQUIRE(next == generation + 3);
+    std::sort(std::begin(changed), std::end(changed));
+    REQUIRE(changed == node_container_t{std::min(node_in_a, node_out_a), std::max(node_in_a, node_out_a)});
+
+    // the changes can be fetched again from an older generation
+    REQUIRE(sim->changed_nodes_since(generation + 1, changed) == next);
+    REQUIRE(changed == node_container_t{node_out_a});
+
+    // init() invalidates the generations from before
+    sim->init();
+    REQUIRE(sim->node_dirty(node_out_b));
+    sim->changed_nodes_since(next, changed);
+    REQUIRE(contains(node_out_b));
+
+    // steps without changes count towards the limit of the log
+    sim->run_until_stable(2);
+    auto quiet = sim->changed_nodes_since(sim->generation(), changed);
+    for (size_t i = 0; i <= CHANGE_LOG_LIMIT; ++i) {
+        sim->step();
+    }
+    REQUIRE(sim->changed_nodes_since(quiet, changed) == quiet + CHANGE_LOG_LIMIT + 1);
+    REQUIRE(contains(node_in_a));
+    REQUIRE(contains(node_out_a));
+    REQUIRE(contains(node_out_b));
+}
+
+TEST_CASE("Run until stable", "[simulator]") {
+
+    const size_t CHAIN_LENGTH = 10;
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    SECTION("chain of inverters") {
+        auto in = circuit_desc->add_connector_in("in", 1);
+        auto out = circuit_desc->add_connector_out("out", 1);
+
+        auto prev = in->pin_id(0);
+        for (size_t idx = 0; idx < CHAIN_LENGTH; ++idx) {
+            auto not_gate = circuit_desc->add_not_gate();
+            circuit_desc->connect(prev, not_gate->pin_id(0));
+            prev = not_gate->pin_id(1);
+        }
+        circuit_desc->connect(prev, out->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        REQUIRE(sim->run_until_stable(2));
+
+        // the input changes in the first step, each inverter takes one more step
+        circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+        auto start = sim->current_time();
+        REQUIRE(sim->steps_until_stable(3) == CHAIN_LENGTH + 1);
+        REQUIRE(sim->current_time() == start + CHAIN_LENGTH + 1 + 3);
+        REQUIRE(sim->nodes_changed_last_step() == 0);
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+
+        // a budget that's too small
+        circuit->write_pin(in->pin_id(0), VALUE_FALSE);
+        REQUIRE(sim->steps_until_stable(2, CHAIN_LENGTH / 2) == STEPS_NOT_STABLE);
+        REQUIRE(sim->nodes_changed_last_step() == 1);
+        REQUIRE(sim->run_until_stable(2, CHAIN_LENGTH));
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+    }
+
+    SECTION("oscillating circuit") {
+        auto not_gate = circuit_desc->add_not_gate();
+        circuit_desc->connect(not_gate->pin_id(1), not_gate->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+
+        auto start = sim->current_time();
+        REQUIRE(!sim->run_until_stable(2, 100));
+        REQUIRE(sim->current_time() == start + 100);
+    }
+}
+
+TEST_CASE("Run with a stop condition", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    SECTION("node values and edges") {
+        auto osc = circuit_desc->add_oscillator(2, 3);
+        auto out = circuit_desc->add_connector_out("out", 1);
+        circuit_desc->connect(osc->pin_id(0), out->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        auto node = circuit->pin_node(out->pin_id(0));
+        sim->init();
+
+        REQUIRE(sim->run(100, RunCondition().rising_edge(node)) != STEPS_NOT_MET);
+        REQUIRE(sim->read_node(node) == VALUE_TRUE);
+
+        // high for 3 steps, low for 2 steps
+        REQUIRE(sim->run(100, RunCondition().falling_edge(node)) == 3);
+        REQUIRE(sim->run(100, RunCondition().rising_edge(node)) == 2);
+
+        // a node that already has the value has to change first
+        REQUIRE(sim->run(100, RunCondition().node_value(node, VALUE_TRUE)) == 5);
+
+        // the step budget
+        auto start = sim->current_time();
+        REQUIRE(sim->run(2, RunCondition().falling_edge(node)) == STEPS_NOT_MET);
+        REQUIRE(sim->current_time() == start + 2);
+        REQUIRE(sim->run(10, RunCondition()) == STEPS_NOT_MET);
+        REQUIRE(sim->current_time() == start + 12);
+
+        // the first term that is met
+        RunCondition condition;
+        condition.node_value(node, VALUE_ERROR).rising_edge(node).falling_edge(node);
+        REQUIRE(condition.num_terms() == 3);
+        auto steps = sim->run(10, condition);
+        REQUIRE(steps != STEPS_NOT_MET);
+        REQUIRE(sim->last_run_term() == (sim->read_node(node) == VALUE_TRUE ? 1 : 2));
+    }
+
+    SECTION("bus value") {
+        auto in = circuit_desc->add_connector_in("in", 4);
+        auto out = circuit_desc->add_connector_out("out", 4);
+        for (uint32_t bit = 0; bit < 4; ++bit) {
+            auto prev = in->pin_id(bit);
+            for (int idx = 0; idx < 3; ++idx) {
+                auto not_gate = circuit_desc->add_not_gate();
+                circuit_desc->connect(prev, not_gate->pin_id(0));
+                prev = not_gate->pin_id(1);
+            }
+            circuit_desc->connect(prev, out->pin_id(bit));
+        }
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        node_container_t bus;
+        for (uint32_t bit = 0; bit < 4; ++bit) {
+            bus.push_back(circuit->pin_node(out->pin_id(bit)));
+        }
+
+        for (auto mode : {TIMING_UNIT_DELAY, TIMING_LEVELIZED}) {
+            sim->set_timing_mode(mode);
+            sim->init();
+            circuit->write_pins({in->pin_id(0), in->pin_id(1), in->pin_id(2), in->pin_id(3)}, 0x0);
+            REQUIRE(sim->run_until_stable(2));
+
+            // the connector drives the new value in the first step, then each inverter takes a step
+            //  (or all of them settle in one step when levelized)
+            circuit->write_pins({in->pin_id(0), in->pin_id(1), in->pin_id(2), in->pin_id(3)}, 0x5);
+            auto expected = mode == TIMING_LEVELIZED ? 2u : 4u;
+            REQUIRE(sim->run(10, RunCondition().bus_value(bus, 0xa)) == expected);
+
+            // only the bits in the mask are compared
+            circuit->write_pins({in->pin_id(0), in->pin_id(1), in->pin_id(2), in->pin_id(3)}, 0x6);
+            REQUIRE(sim->run(10, RunCondition().bus_value(bus, 0x1, 0x3)) == expected);
+            REQUIRE(sim->run(10, RunCondition().bus_value(bus, 0x9)) == STEPS_NOT_MET);
+        }
+    }
+}
+
+TEST_CASE("Watchpoints", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto out = circuit_desc->add_connector_out("out", 1);
+    auto not_gate = circuit_desc->add_not_gate();
+    circuit_desc->connect(in->pin_id(0), not_gate->pin_id(0));
+    circuit_desc->connect(not_gate->pin_id(1), out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+    auto node_in = circuit->pin_node(in->pin_id(0));
+    auto node_out = circuit->pin_node(out->pin_id(0));
+
+    sim->init();
+    REQUIRE(sim->run_until_stable(2));
+    REQUIRE(sim->read_node(node_out) == VALUE_TRUE);
+
+    auto fall = sim->add_watchpoint(node_out, WATCH_FALLING_EDGE);
+    auto rise = sim->add_watchpoint(node_out, WATCH_RISING_EDGE);
+    auto change = sim->add_watchpoint(node_in, WATCH_CHANGE);
+
+    // the input changes in the first step, the output in the second one
+    circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+    auto start = sim->current_time();
+    REQUIRE(!sim->run_until_stable(5));
+    REQUIRE(sim->current_time() == start + 1);
+    REQUIRE(sim->watchpoint_hits().size() == 1);
+    REQUIRE(sim->watchpoint_hits()[0].m_watch == change);
+    REQUIRE(sim->watchpoint_hits()[0].m_node == node_in);
+    REQUIRE(sim->watchpoint_hits()[0].m_time == start + 1);
+
+    REQUIRE(sim->run(10, RunCondition()) == 1);
+    REQUIRE(sim->watchpoint_hits().size() == 1);
+    REQUIRE(sim->watchpoint_hits()[0].m_watch == fall);
+    REQUIRE(sim->watchpoint_hits()[0].m_value == VALUE_FALSE);
+    REQUIRE(sim->watchpoint_hits()[0].m_time == start + 2);
+
+    // nothing changes: the watchpoints don't fire
+    REQUIRE(sim->run_until_stable(5));
+    REQUIRE(!sim->watchpoint_hit());
+
+    // removed watchpoints don't fire, the ids of the others stay valid
+    REQUIRE(sim->remove_watchpoint(change));
+    REQUIRE_FALSE(sim->remove_watchpoint(change));
+    REQUIRE_FALSE(sim->remove_watchpoint(change + 10));
+    auto value = sim->add_watchpoint(node_out, WATCH_VALUE, VALUE_TRUE);
+    circuit->write_pin(in->pin_id(0), VALUE_FALSE);
+    REQUIRE(sim->steps_until_stable(5) == STEPS_WATCHPOINT);
+    REQUIRE(sim->watchpoint_hits().size() == 2);
+    REQUIRE(sim->watchpoint_hits()[0].m_watch == rise);
+    REQUIRE(sim->watchpoint_hits()[1].m_watch == value);
+
+    // ids are never reused: not after removing the last watchpoint, nor after clearing all of them
+    REQUIRE(sim->remove_watchpoint(value));
+    auto again = sim->add_watchpoint(node_out, WATCH_CHANGE);
+    REQUIRE(again != value);
+    REQUIRE_FALSE(sim->remove_watchpoint(value));
+    sim->clear_watchpoints();
+    REQUIRE_FALSE(sim->remove_watchpoint(again));
+
+    // init resets the last values of the watched nodes
+    auto cleared = sim->add_watchpoint(node_out, WATCH_CHANGE);
+    REQUIRE(cleared > again);
+    sim->init();
+    REQUIRE(sim->run(10, RunCondition()) != STEPS_NOT_MET);
+    REQUIRE(sim->watchpoint_hits()[0].m_watch == cleared);
+    REQUIRE(sim->read_node(node_out) == VALUE_TRUE);
+}
+
+TEST_CASE("Netlist optimizations", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 2);
+    auto out = circuit_desc->add_connector_out("out", 3);
+    auto high = circuit_desc->add_constant(VALUE_TRUE);
+    auto low = circuit_desc->add_constant(VALUE_FALSE);
+    auto pull_up = circuit_desc->add_pull_resistor(VALUE_TRUE);
+
+    // and(1, 0) -> not: both gates fold to a constant
+    auto and_const = circuit_desc->add_and_gate(2);
+    auto not_const = circuit_desc->add_not_gate();
+    circuit_desc->connect(high->pin_id(0), and_const->pin_id(0));
+    circuit_desc->connect(low->pin_id(0), and_const->pin_id(1));
+    circuit_desc->connect(and_const->pin_id(2), not_const->pin_id(0));
+    circuit_desc->connect(and_const->pin_id(2), out->pin_id(2));
+
+    // gates with one constant input stay
+    auto and_out = circuit_desc->add_and_gate(2);
+    circuit_desc->connect(not_const->pin_id(1), and_out->pin_id(0));
+    circuit_desc->connect(in->pin_id(0), and_out->pin_id(1));
+    circuit_desc->connect(and_out->pin_id(2), out->pin_id(0));
+
+    auto xor_out = circuit_desc->add_xor_gate();
+    circuit_desc->connect(pull_up->pin_id(0), xor_out->pin_id(0));
+    circuit_desc->connect(in->pin_id(1), xor_out->pin_id(1));
+    circuit_desc->connect(xor_out->pin_id(2), out->pin_id(1));
+
+    // a chain of inverters that doesn't drive anything
+    auto not_a = circuit_desc->add_not_gate();
+    auto not_b = circuit_desc->add_not_gate();
+    circuit_desc->connect(in->pin_id(0), not_a->pin_id(0));
+    circuit_desc->connect(not_a->pin_id(1), not_b->pin_id(0));
+
+    auto check_outputs = [&](SimCircuit *circuit) {
+        for (int data = 0; data < 4; ++data) {
+            circuit->write_pin(in->pin_id(0), static_cast<Value>(data & 1));
+            circuit->write_pin(in->pin_id(1), static_cast<Value>((data >> 1) & 1));
+            REQUIRE(sim->run_until_stable(2));
+            REQUIRE(circuit->read_pin(out->pin_id(0)) == static_cast<Value>(data & 1));
+            REQUIRE(circuit->read_pin(out->pin_id(1)) == static_cast<Value>(((data >> 1) & 1) ^ 1));
+            REQUIRE(circuit->read_pin(out->pin_id(2)) == VALUE_FALSE);
+        }
+    };
+
+    SECTION("no optimizations") {
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        check_outputs(circuit.get());
+
+        REQUIRE(sim->netlist_optimizations() == OPTIMIZE_NONE);
+        REQUIRE(sim->netlist_reduction().m_folded_gates == 0);
+        REQUIRE(sim->netlist_reduction().m_dead_gates == 0);
+        REQUIRE(circuit->read_pin(not_b->pin_id(1)) == VALUE_TRUE);
+    }
+
+    SECTION("constant propagation") {
+        sim->set_netlist_optimizations(OPTIMIZE_CONSTANTS);
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+
+        REQUIRE(sim->netlist_reduction().m_folded_gates == 2);
+        REQUIRE(sim->netlist_reduction().m_dead_gates == 2);
+
+        // the outputs of the folded gates keep their constant value
+        REQUIRE(circuit->read_pin(and_const->pin_id(2)) == VALUE_FALSE);
+        REQUIRE(circuit->read_pin(not_const->pin_id(1)) == VALUE_TRUE);
+        check_outputs(circuit.get());
+        REQUIRE(circuit->read_pin(not_const->pin_id(1)) == VALUE_TRUE);
+
+        // the dead gates aren't evaluated, their outputs keep the initial value
+        auto dead_value = circuit->read_pin(not_a->pin_id(1));
+        circuit->write_pin(in->pin_id(0), VALUE_FALSE);
+        REQUIRE(sim->run_until_stable(2));
+        REQUIRE(circuit->read_pin(not_a->pin_id(1)) == dead_value);
+        circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+        REQUIRE(sim->run_until_stable(2));
+        REQUIRE(circuit->read_pin(not_a->pin_id(1)) == dead_value);
+
+        // an observed pin keeps its drivers alive
+        sim->pin_set_observed(circuit->pin_from_pin_id(not_b->pin_id(1)));
+        sim->init();
+        REQUIRE(sim->netlist_reduction().m_dead_gates == 0);
+        check_outputs(circuit.get());
+        REQUIRE(circuit->read_pin(not_b->pin_id(1)) == circuit->read_pin(in->pin_id(0)));
+    }
+}
+
+TEST_CASE("Constant propagation through sub-circuits", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto inv_desc = lsim_context.create_user_circuit("inv");
+    auto i_in = inv_desc->add_connector_in("in", 1);
+    auto i_out = inv_desc->add_connector_out("out", 1);
+    auto i_not = inv_desc->add_not_gate();
+    inv_desc->connect(i_in->pin_id(0), i_not->pin_id(0));
+    inv_desc->connect(i_not->pin_id(1), i_out->pin_id(0));
+
+    // constant -> inv -> inv: folds across the ports of both sub-circuits
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    auto out = circuit_desc->add_connector_out("out", 2);
+    auto high = circuit_desc->add_constant(VALUE_TRUE);
+    auto inv_1 = circuit_desc->add_sub_circuit("inv");
+    auto inv_2 = circuit_desc->add_sub_circuit("inv");
+    circuit_desc->connect(high->pin_id(0), inv_1->port_by_name("in"));
+    circuit_desc->connect(inv_1->port_by_name("out"), inv_2->port_by_name("in"));
+    circuit_desc->connect(inv_1->port_by_name("out"), out->pin_id(0));
+    circuit_desc->connect(inv_2->port_by_name("out"), out->pin_id(1));
+
+    sim->set_netlist_optimizations(OPTIMIZE_CONSTANTS);
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+    sim->init();
+
+    REQUIRE(sim->netlist_reduction().m_folded_gates == 2);
+    REQUIRE(sim->netlist_reduction().m_dead_gates == 0);
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+    REQUIRE(circuit->read_pin(out->pin_id(1)) == VALUE_TRUE);
+    REQUIRE(sim->run_until_stable(2));
+    REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+    REQUIRE(circuit->read_pin(out->pin_id(1)) == VALUE_TRUE);
+}
+
+TEST_CASE("Merge duplicate gates", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 3);
+    auto out = circuit_desc->add_connector_out("out", 4);
+
+    // two copies of not(in0) & in1, the inputs of the and gates are swapped
+    auto not_1 = circuit_desc->add_not_gate();
+    auto not_2 = circuit_desc->add_not_gate();
+    auto and_1 = circuit_desc->add_and_gate(2);
+    auto and_2 = circuit_desc->add_and_gate(2);
+    circuit_desc->connect(in->pin_id(0), not_1->pin_id(0));
+    circuit_desc->connect(in->pin_id(0), not_2->pin_id(0));
+    circuit_desc->connect(not_1->pin_id(1), and_1->pin_id(0));
+    circuit_desc->connect(in->pin_id(1), and_1->pin_id(1));
+    circuit_desc->connect(in->pin_id(1), and_2->pin_id(0));
+    circuit_desc->connect(not_2->pin_id(1), and_2->pin_id(1));
+    circuit_desc->connect(and_1->pin_id(2), out->pin_id(0));
+    circuit_desc->connect(and_2->pin_id(2), out->pin_id(1));
+
+    // tri-state and wired outputs aren't merged
+    auto buf_1 = circuit_desc->add_tristate_buffer(1);
+    auto buf_2 = circuit_desc->add_tristate_buffer(1);
+    circuit_desc->connect(in->pin_id(0), buf_1->pin_id(0));
+    circuit_desc->connect(in->pin_id(0), buf_2->pin_id(0));
+    circuit_desc->connect(in->pin_id(2), buf_1->pin_id(2));
+    circuit_desc->connect(in->pin_id(2), buf_2->pin_id(2));
+    circuit_desc->connect(buf_1->pin_id(1), out->pin_id(2));
+    circuit_desc->connect(buf_2->pin_id(1), out->pin_id(2));
+
+    auto or_1 = circuit_desc->add_or_gate(2);
+    auto or_2 = circuit_desc->add_or_gate(2);
+    auto or_3 = circuit_desc->add_or_gate(2);
+    for (auto gate : {or_1, or_2, or_3}) {
+        circuit_desc->connect(in->pin_id(1), gate->pin_id(0));
+        circuit_desc->connect(in->pin_id(2), gate->pin_id(1));
+    }
+    circuit_desc->connect(or_1->pin_id(2), out->pin_id(3));
+    circuit_desc->connect(or_2->pin_id(2), out->pin_id(3));
+
+    SECTION("no optimizations") {
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        REQUIRE(sim->netlist_reduction().m_merged_gates == 0);
+        REQUIRE(circuit->pin_node(not_1->pin_id(1)) != circuit->pin_node(not_2->pin_id(1)));
+    }
+
+    SECTION("merge gates") {
+        sim->set_netlist_optimizations(OPTIMIZE_MERGE_GATES);
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+
+        // the and gates are only equal after the inverters were merged
+        REQUIRE(sim->netlist_reduction().m_merged_gates == 2);
+        REQUIRE(circuit->pin_node(not_1->pin_id(1)) == circuit->pin_node(not_2->pin_id(1)));
+        REQUIRE(circuit->pin_node(and_1->pin_id(2)) == circuit->pin_node(and_2->pin_id(2)));
+        REQUIRE(circuit->pin_node(buf_1->pin_id(1)) == circuit->pin_node(buf_2->pin_id(1)));
+        REQUIRE(circuit->pin_node(or_1->pin_id(2)) != circuit->pin_node(or_3->pin_id(2)));
+
+        for (int data = 0; data < 4; ++data) {
+            circuit->write_pin(in->pin_id(0), static_cast<Value>(data & 1));
+            circuit->write_pin(in->pin_id(1), static_cast<Value>((data >> 1) & 1));
+            REQUIRE(sim->run_until_stable(2));
+
+            auto expected = static_cast<Value>(((data & 1) ^ 1) & ((data >> 1) & 1));
+            REQUIRE(circuit->read_pin(out->pin_id(0)) == expected);
+            REQUIRE(circuit->read_pin(out->pin_id(1)) == expected);
+            REQUIRE(circuit->read_pin(and_2->pin_id(2)) == expected);
+        }
+    }
+}
+
+TEST_CASE("Merge gates in parallel sub-circuits", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto inv_desc = lsim_context.create_user_circuit("inv");
+    auto i_in = inv_desc->add_connector_in("in", 1);
+    auto i_out = inv_desc->add_connector_out("out", 1);
+    auto i_not = inv_desc->add_not_gate();
+    inv_desc->connect(i_in->pin_id(0), i_not->pin_id(0));
+    inv_desc->connect(i_not->pin_id(1), i_out->pin_id(0));
+
+    // two identical instances on the same input
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto out = circuit_desc->add_connector_out("out", 2);
+    auto inv_1 = circuit_desc->add_sub_circuit("inv");
+    auto inv_2 = circuit_desc->add_sub_circuit("inv");
+    circuit_desc->connect(in->pin_id(0), inv_1->port_by_name("in"));
+    circuit_desc->connect(in->pin_id(0), inv_2->port_by_name("in"));
+    circuit_desc->connect(inv_1->port_by_name("out"), out->pin_id(0));
+    circuit_desc->connect(inv_2->port_by_name("out"), out->pin_id(1));
+
+    sim->set_netlist_optimizations(OPTIMIZE_MERGE_GATES);
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+    sim->init();
+
+    REQUIRE(sim->netlist_reduction().m_merged_gates == 1);
+    REQUIRE(circuit->pin_node(out->pin_id(0)) == circuit->pin_node(out->pin_id(1)));
+
+    for (int data = 0; data < 2; ++data) {
+        circuit->write_pin(in->pin_id(0), static_cast<Value>(data));
+        REQUIRE(sim->run_until_stable(2));
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == static_cast<Value>(data ^ 1));
+        REQUIRE(circuit->read_pin(out->pin_id(1)) == static_cast<Value>(data ^ 1));
+    }
+}
+
+TEST_CASE("Component arenas", "[simulator]") {
+
+    const size_t NUM_OSCILLATORS = 50;
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    std::vector<ModelComponent *> oscillators;
+    std::vector<ModelComponent *> gates;
+    for (size_t idx = 0; idx < NUM_OSCILLATORS; ++idx) {
+        oscillators.push_back(circuit_desc->add_oscillator(idx + 1, idx + 2));
+        gates.push_back(circuit_desc->add_and_gate(3));
+    }
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+    REQUIRE(sim->num_components() == 2 * NUM_OSCILLATORS);
+
+    // the pins of a component are consecutive in the pin arena
+    for (size_t idx = 0; idx < NUM_OSCILLATORS; ++idx) {
+        auto gate = circuit->component_by_id(gates[idx]->id());
+        REQUIRE(gate->num_pins() == 4);
+        REQUIRE(sim->component_pins(gate->id()) == gate->pins());
+        for (uint32_t pin = 1; pin < gate->num_pins(); ++pin) {
+            REQUIRE(gate->pin_by_index(pin) == gate->pin_by_index(0) + pin);
+        }
+    }
+
+    // the extra data of each component is separate and is reused by the next init
+    for (int run = 0; run < 2; ++run) {
+        sim->init();
+        for (size_t idx = 0; idx < NUM_OSCILLATORS; ++idx) {
+            auto osc = circuit->component_by_id(oscillators[idx]->id());
+            auto *extra = reinterpret_cast<ExtraDataOscillator *>(osc->extra_data());
+            REQUIRE(reinterpret_cast<uintptr_t>(extra) % alignof(ExtraDataOscillator) == 0);
+            REQUIRE(extra->m_duration[0] == static_cast<int64_t>(idx + 1));
+            REQUIRE(extra->m_duration[1] == static_cast<int64_t>(idx + 2));
+        }
+    }
+}
+
+TEST_CASE("Snapshot and restore", "[simulator]") {
+
+    const int NUM_STEPS = 60;
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto out = circuit_desc->add_connector_out("out", 1);
+    auto osc = circuit_desc->add_oscillator(3, 5);
+    auto xor_gate = circuit_desc->add_xor_gate();
+    auto not_gate = circuit_desc->add_not_gate();
+    not_gate->set_propagation_delay(2, 3, 4, 5, 6, 8);
+    circuit_desc->connect(in->pin_id(0), xor_gate->pin_id(0));
+    circuit_desc->connect(osc->pin_id(0), xor_gate->pin_id(1));
+    circuit_desc->connect(xor_gate->pin_id(2), not_gate->pin_id(0));
+    circuit_desc->connect(not_gate->pin_id(1), out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    // output of the circuit for a fixed sequence of inputs
+    auto trace = [&]() {
+        value_container_t result;
+        for (int step = 0; step < NUM_STEPS; ++step) {
+            if (step % 7 == 0) {
+                circuit->write_pin(in->pin_id(0), (step / 7) % 2 ? VALUE_TRUE : VALUE_FALSE);
+            }
+            sim->step();
+            result.push_back(circuit->read_pin(out->pin_id(0)));
+        }
+        return result;
+    };
+
+    for (auto mode : {TIMING_UNIT_DELAY, TIMING_TYPICAL}) {
+        sim->set_timing_mode(mode);
+        sim->init();
+        circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+        for (int step = 0; step < 12; ++step) {
+            sim->step();
+        }
+
+        auto checkpoint = sim->snapshot();
+        auto start_time = sim->current_time();
+        auto expected = trace();
+        REQUIRE(std::count(expected.begin(), expected.end(), VALUE_TRUE) > 0);
+        REQUIRE(std::count(expected.begin(), expected.end(), VALUE_FALSE) > 0);
+        auto generation = sim->generation();
+
+        for (int run = 0; run < 3; ++run) {
+            REQUIRE(sim->restore(checkpoint));
+            REQUIRE(sim->current_time() == start_time);
+            REQUIRE(sim->generation() > generation);
+            REQUIRE(trace() == expected);
+            generation = sim->generation();
+        }
+    }
+
+    SECTION("writes outside of a step are part of the snapshot") {
+        sim->init();
+        for (int step = 0; step < 12; ++step) {
+            sim->step();
+        }
+        auto in_pin = circuit->pin_from_pin_id(in->pin_id(0));
+        auto value = sim->read_pin(in_pin) == VALUE_TRUE ? VALUE_FALSE : VALUE_TRUE;
+
+        sim->write_pin(in_pin, value);
+        auto checkpoint = sim->snapshot();
+        sim->step();
+        REQUIRE(sim->read_pin(in_pin) == value);
+
+        sim->write_pin(in_pin, VALUE_UNDEFINED);
+        sim->step();
+        REQUIRE(sim->restore(checkpoint));
+        sim->step();
+        REQUIRE(sim->read_pin(in_pin) == value);
+    }
+
+    SECTION("snapshots of another netlist are refused") {
+        LSimContext other_context;
+        auto other_sim = other_context.sim();
+        auto other_desc = other_context.create_user_circuit("main");
+        other_desc->add_not_gate();
+        auto other_circuit = other_desc->instantiate(other_sim);
+        REQUIRE(other_circuit);
+        other_sim->init();
+
+        sim->init();
+        REQUIRE_FALSE(sim->restore(other_sim->snapshot()));
+        REQUIRE_FALSE(other_sim->restore(sim->snapshot()));
+
+        // changing the netlist invalidates the existing snapshots
+        auto checkpoint = sim->snapshot();
+        auto extra = circuit_desc->instantiate(sim);
+        REQUIRE(extra);
+        REQUIRE_FALSE(sim->restore(checkpoint));
+    }
+}
+
+TEST_CASE("Fork a simulation", "[simulator]") {
+
+    const int NUM_FORKS = 4;
+    const int NUM_STEPS = 200;
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    // a counter driven by an oscillator, the input selects the value of the first bit
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 2);
+    auto out = circuit_desc->add_connector_out("out", 2);
+    auto osc = circuit_desc->add_oscillator(2, 3);
+    auto and_gate = circuit_desc->add_and_gate(2);
+    auto xor_gate = circuit_desc->add_xor_gate();
+    circuit_desc->connect(in->pin_id(0), and_gate->pin_id(0));
+    circuit_desc->connect(osc->pin_id(0), and_gate->pin_id(1));
+    circuit_desc->connect(and_gate->pin_id(2), out->pin_id(0));
+    circuit_desc->connect(in->pin_id(1), xor_gate->pin_id(0));
+    circuit_desc->connect(osc->pin_id(0), xor_gate->pin_id(1));
+    circuit_desc->connect(xor_gate->pin_id(2), out->pin_id(1));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    sim->init();
+    for (int step = 0; step < 17; ++step) {
+        sim->step();
+    }
+    auto checkpoint = sim->snapshot();
+
+    auto run = [&](Simulator *s, SimCircuit *c, int branch) {
+        std::vector<uint64_t> trace;
+        c->write_pin(in->pin_id(0), branch & 1 ? VALUE_TRUE : VALUE_FALSE);
+        c->write_pin(in->pin_id(1), branch & 2 ? VALUE_TRUE : VALUE_FALSE);
+        for (int step = 0; step < NUM_STEPS; ++step) {
+            s->step();
+            trace.push_back(c->read_pins({out->pin_id(0), out->pin_id(1)}));
+        }
+        return trace;
+    };
+
+    // fork before running the reference traces on the original simulator
+    std::vector<std::unique_ptr<Simulator>> forks;
+    std::vector<std::unique_ptr<SimCircuit>> fork_circuits;
+    for (int branch = 0; branch < NUM_FORKS; ++branch) {
+        forks.push_back(sim->fork());
+        fork_circuits.push_back(circuit->clone(forks.back().get()));
+        REQUIRE(forks.back()->current_time() == sim->current_time());
+        REQUIRE(forks.back()->num_pins() == sim->num_pins());
+    }
+
+    std::vector<std::vector<uint64_t>> expected;
+    for (int branch = 0; branch < NUM_FORKS; ++branch) {
+        sim->restore(checkpoint);
+        expected.push_back(run(sim, circuit.get(), branch));
+    }
+
+    // the forks run concurrently
+    std::vector<std::vector<uint64_t>> results(NUM_FORKS);
+    std::vector<std::thread> threads;
+    for (int branch = 0; branch < NUM_FORKS; ++branch) {
+        threads.emplace_back([&, branch]() {
+            results[branch] = run(forks[branch].get(), fork_circuits[branch].get(), branch);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (int branch = 0; branch < NUM_FORKS; ++branch) {
+        REQUIRE(results[branch] == expected[branch]);
+    }
+    REQUIRE(expected[0] != expected[3]);
+}
+
+TEST_CASE("Multi-threaded simulation", "[simulator]") {
+
+    const size_t NUM_ADDERS = 16;
+    const size_t NUM_BITS = 8;
+
+    struct Adders {
+        std::unique_ptr<SimCircuit> m_circuit;
+        ModelComponent *m_in;
+        ModelComponent *m_out;
+    };
+
+    // 16 independent 8-bit ripple carry adders: enough gates to spread the simulation steps over the threads
+    auto build_adders = [=](LSimContext &context) {
+        auto circuit_desc = context.create_user_circuit("main");
+        auto in = circuit_desc->add_connector_in("in", NUM_ADDERS * NUM_BITS * 2);
+        auto out = circuit_desc->add_connector_out("out", NUM_ADDERS * (NUM_BITS + 1));
+
+        for (auto adder = 0u; adder < NUM_ADDERS; ++adder) {
+            auto carry = circuit_desc->add_constant(VALUE_FALSE)->pin_id(0);
+
+            for (auto bit = 0u; bit < NUM_BITS; ++bit) {
+                auto in_a = in->pin_id((adder * NUM_BITS + bit) * 2);
+                auto in_b = in->pin_id((adder * NUM_BITS + bit) * 2 + 1);
+                auto xor_ab = circuit_desc->add_xor_gate();
+                auto xor_sum = circuit_desc->add_xor_gate();
+                auto and_ab = circuit_desc->add_and_gate(2);
+                auto and_c = circuit_desc->add_and_gate(2);
+                auto or_carry = circuit_desc->add_or_gate(2);
+
+                circuit_desc->connect(in_a, xor_ab->pin_id(0));
+                circuit_desc->connect(in_b, xor_ab->pin_id(1));
+                circuit_desc->connect(xor_ab->pin_id(2), xor_sum->pin_id(0));
+                circuit_desc->connect(carry, xor_sum->pin_id(1));
+                circuit_desc->connect(xor_sum->pin_id(2), out->pin_id(adder * (NUM_BITS + 1) + bit));
+                circuit_desc->connect(in_a, and_ab->pin_id(0));
+                circuit_desc->connect(in_b, and_ab->pin_id(1));
+                circuit_desc->connect(xor_ab->pin_id(2), and_c->pin_id(0));
+                circuit_desc->connect(carry, and_c->pin_id(1));
+                circuit_desc->connect(and_ab->pin_id(2), or_carry->pin_id(0));
+                circuit_desc->connect(and_c->pin_id(2), or_carry->pin_id(1));
+                carry = or_carry->pin_id(2);
+            }
+            circuit_desc->connect(carry, out->pin_id(adder * (NUM_BITS + 1) + NUM_BITS));
+        }
+
+        return Adders{circuit_desc->instantiate(context.sim()), in, out};
+    };
+
+    LSimContext context_serial;
+    LSimContext context_parallel;
+    auto serial = build_adders(context_serial);
+    auto parallel = build_adders(context_parallel);
+
+    context_parallel.sim()->set_num_threads(4);
+    REQUIRE(context_parallel.sim()->num_threads() == 4);
+
+    context_serial.sim()->init();
+    context_parallel.sim()->init();
+
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+    int parallel_steps = 0;
+
+    for (int round = 0; round < 10; ++round) {
+        for (auto pin = 0u; pin < NUM_ADDERS * NUM_BITS * 2; ++pin) {
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            auto value = (random & 1) ? VALUE_TRUE : VALUE_FALSE;
+            serial.m_circuit->write_pin(serial.m_in->pin_id(pin), value);
+            parallel.m_circuit->write_pin(parallel.m_in->pin_id(pin), value);
+        }
+
+        // compare the outputs after every step, not only when the circuit is stable
+        for (auto step = 0u; step < 2 * NUM_BITS + 4; ++step) {
+            context_serial.sim()->step();
+            context_parallel.sim()->step();
+
+            auto &stats = context_parallel.sim()->last_step_stats();
+            REQUIRE(stats.m_parallel == (stats.m_dirty_components >= PARALLEL_STEP_THRESHOLD));
+            if (stats.m_parallel) {
+                REQUIRE(stats.m_pool.m_num_tasks > 1);
+                parallel_steps += 1;
+            }
+
+            for (auto pin = 0u; pin < NUM_ADDERS * (NUM_BITS + 1); ++pin) {
+                REQUIRE(serial.m_circuit->read_pin(serial.m_out->pin_id(pin)) ==
+                        parallel.m_circuit->read_pin(parallel.m_out->pin_id(pin)));
+            }
+        }
+    }
+
+    REQUIRE(parallel_steps > 0);
+}
+
+TEST_CASE("Worker pool", "[simulator]") {
+
+    WorkerPool pool;
+    pool.start(4);
+    REQUIRE(pool.num_threads() == 4);
+
+    // tasks of very different cost: every task should run exactly once
+    std::vector<std::atomic<int>> counts(1000);
+    for (int run = 0; run < 20; ++run) {
+        auto stats = pool.run(counts.size(), [&](size_t task) {
+            volatile size_t sink = 0;
+            for (size_t i = 0; i < (task % 7) * 1000; ++i) {
+                sink = sink + i;
+            }
+            counts[task] += 1;
+        });
+        REQUIRE(stats.m_num_tasks == counts.size());
+        REQUIRE(stats.m_efficiency >= 0);
+    }
+
+    for (const auto &count : counts) {
+        REQUIRE(count == 20);
+    }
+
+    pool.stop();
+    REQUIRE(pool.num_threads() == 1);
+}
+
+TEST_CASE("Propagation delays", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto out = circuit_desc->add_connector_out("out", 1);
+    auto not_gate = circuit_desc->add_not_gate();
+    not_gate->set_propagation_delay(2, 3, 4, 5, 6, 8);
+    circuit_desc->connect(in->pin_id(0), not_gate->pin_id(0));
+    circuit_desc->connect(not_gate->pin_id(1), out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    // number of steps it takes for a change of the input to reach the output
+    auto measure = [&](Value input) {
+        circuit->write_pin(in->pin_id(0), input);
+        sim->step();        // connector drives the new value
+        int steps = 0;
+        while (circuit->read_pin(out->pin_id(0)) == input) {
+            sim->step();
+            ++steps;
+        }
+        sim->run_until_stable(10);
+        return steps;
+    };
+
+    SECTION("unit delay") {
+        sim->init();
+        sim->run_until_stable(10);
+        REQUIRE(measure(VALUE_TRUE) == 1);
+        REQUIRE(measure(VALUE_FALSE) == 1);
+    }
+
+    SECTION("typical delay") {
+        sim->set_timing_mode(TIMING_TYPICAL);
+        sim->init();
+        sim->run_until_stable(10);
+        REQUIRE(measure(VALUE_TRUE) == 6);
+        REQUIRE(measure(VALUE_FALSE) == 3);
+    }
+
+    SECTION("minimum & maximum delay") {
+        sim->set_timing_mode(TIMING_MINIMUM);
+        sim->init();
+        sim->run_until_stable(10);
+        REQUIRE(measure(VALUE_TRUE) == 5);
+        REQUIRE(measure(VALUE_FALSE) == 2);
+
+        sim->set_timing_mode(TIMING_MAXIMUM);
+        sim->init();
+        sim->run_until_stable(10);
+        REQUIRE(measure(VALUE_TRUE) == 8);
+        REQUIRE(measure(VALUE_FALSE) == 4);
+    }
+
+    SECTION("random delay") {
+        for (uint64_t seed = 0; seed < 10; ++seed) {
+            sim->set_timing_mode(TIMING_RANDOM, seed);
+            sim->init();
+            sim->run_until_stable(10);
+            auto fall = measure(VALUE_TRUE);
+            auto rise = measure(VALUE_FALSE);
+            REQUIRE(fall >= 5);
+            REQUIRE(fall <= 8);
+            REQUIRE(rise >= 2);
+            REQUIRE(rise <= 4);
+            REQUIRE(measure(VALUE_TRUE) == fall);
+        }
+    }
+
+    SECTION("pulses shorter than the delay are filtered") {
+        sim->set_timing_mode(TIMING_TYPICAL);
+        sim->init();
+        sim->run_until_stable(10);
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+
+        circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+        sim->step();
+        sim->step();
+        circuit->write_pin(in->pin_id(0), VALUE_FALSE);
+        for (int i = 0; i < 20; ++i) {
+            sim->step();
+            REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+        }
+    }
+}
+
+TEST_CASE("Tri-state buffer disabled within its delay", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    auto in = circuit_desc->add_connector_in("in", 1);
+    auto en = circuit_desc->add_connector_in("en", 1);
+    auto out = circuit_desc->add_connector_out("out", 1);
+    auto buffer = circuit_desc->add_tristate_buffer(1);
+    buffer->set_propagation_delay(4, 4);
+    circuit_desc->connect(in->pin_id(0), buffer->pin_id(0));
+    circuit_desc->connect(en->pin_id(0), buffer->pin_id(2));
+    circuit_desc->connect(buffer->pin_id(1), out->pin_id(0));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    sim->set_timing_mode(TIMING_TYPICAL);
+    sim->init();
+    circuit->write_pin(in->pin_id(0), VALUE_TRUE);
+    circuit->write_pin(en->pin_id(0), VALUE_FALSE);
+    sim->run_until_stable(10);
+    auto idle = circuit->read_pin(out->pin_id(0));
+    REQUIRE(idle != VALUE_TRUE);
+
+    // enable the buffer and disable it again before the rise delay has passed
+    circuit->write_pin(en->pin_id(0), VALUE_TRUE);
+    sim->step();
+    sim->step();
+    circuit->write_pin(en->pin_id(0), VALUE_FALSE);
+    for (int i = 0; i < 20; ++i) {
+        sim->step();
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == idle);
+    }
+}
+
+TEST_CASE("Levelized evaluation", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    SECTION("combinational logic settles in one step") {
+        auto in_a = circuit_desc->add_connector_in("a", 8);
+        auto in_b = circuit_desc->add_connector_in("b", 8);
+        auto out = circuit_desc->add_connector_out("s", 9);
+
+        auto carry = circuit_desc->add_constant(VALUE_FALSE)->pin_id(0);
+        for (auto bit = 0u; bit < 8; ++bit) {
+            auto xor_ab = circuit_desc->add_xor_gate();
+            auto xor_sum = circuit_desc->add_xor_gate();
+            auto nand_ab = circuit_desc->add_nand_gate(2);
+            auto nand_c = circuit_desc->add_nand_gate(2);
+            auto nand_carry = circuit_desc->add_nand_gate(2);
+
+            circuit_desc->connect(in_a->pin_id(bit), xor_ab->pin_id(0));
+            circuit_desc->connect(in_b->pin_id(bit), xor_ab->pin_id(1));
+            circuit_desc->connect(xor_ab->pin_id(2), xor_sum->pin_id(0));
+            circuit_desc->connect(carry, xor_sum->pin_id(1));
+            circuit_desc->connect(xor_sum->pin_id(2), out->pin_id(bit));
+            circuit_desc->connect(in_a->pin_id(bit), nand_ab->pin_id(0));
+            circuit_desc->connect(in_b->pin_id(bit), nand_ab->pin_id(1));
+            circuit_desc->connect(xor_ab->pin_id(2), nand_c->pin_id(0));
+            circuit_desc->connect(carry, nand_c->pin_id(1));
+            circuit_desc->connect(nand_ab->pin_id(2), nand_carry->pin_id(0));
+            circuit_desc->connect(nand_c->pin_id(2), nand_carry->pin_id(1));
+            carry = nand_carry->pin_id(2);
+        }
+        circuit_desc->connect(carry, out->pin_id(8));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+
+        sim->set_timing_mode(TIMING_LEVELIZED);
+        sim->init();
+
+        for (int a = 0; a < 256; a += 7) {
+            for (int b = 0; b < 256; b += 11) {
+                circuit->write_output_pins(in_a->id(), a);
+                circuit->write_output_pins(in_b->id(), b);
+
+                // one step to apply the input values, one step to settle the adder
+                sim->step();
+                sim->step();
+                int sum = 0;
+                for (auto bit = 0u; bit < 9; ++bit) {
+                    sum |= (circuit->read_pin(out->pin_id(bit)) == VALUE_TRUE) << bit;
+                }
+                REQUIRE(sum == a + b);
+            }
+        }
+    }
+
+    SECTION("feedback loops keep a unit delay") {
+        auto in = circuit_desc->add_connector_in("in", 2);
+        auto out = circuit_desc->add_connector_out("out", 2);
+        auto not_s = circuit_desc->add_not_gate();
+        auto not_r = circuit_desc->add_not_gate();
+        auto nand_q = circuit_desc->add_nand_gate(2);
+        auto nand_nq = circuit_desc->add_nand_gate(2);
+
+        // set/reset latch, with active high inputs
+        circuit_desc->connect(in->pin_id(0), not_s->pin_id(0));
+        circuit_desc->connect(in->pin_id(1), not_r->pin_id(0));
+        circuit_desc->connect(not_s->pin_id(1), nand_q->pin_id(0));
+        circuit_desc->connect(not_r->pin_id(1), nand_nq->pin_id(0));
+        circuit_desc->connect(nand_nq->pin_id(2), nand_q->pin_id(1));
+        circuit_desc->connect(nand_q->pin_id(2), nand_nq->pin_id(1));
+        circuit_desc->connect(nand_q->pin_id(2), out->pin_id(0));
+        circuit_desc->connect(nand_nq->pin_id(2), out->pin_id(1));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+
+        sim->set_timing_mode(TIMING_LEVELIZED);
+        sim->init();
+
+        circuit->write_output_pins(in->id(), 1);
+        sim->run_until_stable(2);
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+        REQUIRE(circuit->read_pin(out->pin_id(1)) == VALUE_FALSE);
+
+        circuit->write_output_pins(in->id(), 0);
+        sim->run_until_stable(2);
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_TRUE);
+        REQUIRE(circuit->read_pin(out->pin_id(1)) == VALUE_FALSE);
+
+        circuit->write_output_pins(in->id(), 2);
+        sim->run_until_stable(2);
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+        REQUIRE(circuit->read_pin(out->pin_id(1)) == VALUE_TRUE);
+
+        circuit->write_output_pins(in->id(), 0);
+        sim->run_until_stable(2);
+        REQUIRE(circuit->read_pin(out->pin_id(0)) == VALUE_FALSE);
+        REQUIRE(circuit->read_pin(out->pin_id(1)) == VALUE_TRUE);
+    }
+}
+
+TEST_CASE("Cycle based simulation", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    // d-latch built from nand gates, transparent when 'enable' is high
+    auto d_latch = [=](pin_id_t d, pin_id_t enable) {
+        auto not_d = circuit_desc->add_not_gate();
+        auto nand_s = circuit_desc->add_nand_gate(2);
+        auto nand_r = circuit_desc->add_nand_gate(2);
+        auto nand_q = circuit_desc->add_nand_gate(2);
+        auto nand_nq = circuit_desc->add_nand_gate(2);
+        // start in a consistent state, otherwise the cross-coupled gates oscillate
+        nand_s->property("initial_output")->value(VALUE_TRUE);
+        nand_r->property("initial_output")->value(VALUE_TRUE);
+        nand_q->property("initial_output")->value(VALUE_FALSE);
+        nand_nq->property("initial_output")->value(VALUE_TRUE);
+
+        circuit_desc->connect(d, not_d->pin_id(0));
+        circuit_desc->connect(d, nand_s->pin_id(0));
+        circuit_desc->connect(enable, nand_s->pin_id(1));
+        circuit_desc->connect(not_d->pin_id(1), nand_r->pin_id(0));
+        circuit_desc->connect(enable, nand_r->pin_id(1));
+        circuit_desc->connect(nand_s->pin_id(2), nand_q->pin_id(0));
+        circuit_desc->connect(nand_nq->pin_id(2), nand_q->pin_id(1));
+        circuit_desc->connect(nand_r->pin_id(2), nand_nq->pin_id(0));
+        circuit_desc->connect(nand_q->pin_id(2), nand_nq->pin_id(1));
+        return nand_q->pin_id(2);
+    };
+
+    // rising edge triggered d-flipflop: master-slave pair of d-latches
+    auto d_flipflop = [=](pin_id_t d, pin_id_t clock) {
+        auto not_clock = circuit_desc->add_not_gate();
+        circuit_desc->connect(clock, not_clock->pin_id(0));
+        auto master = d_latch(d, not_clock->pin_id(1));
+        return d_latch(master, clock);
+    };
+
+    // 2-bit synchronous counter
+    auto build_counter = [=](pin_id_t clock) {
+        auto out = circuit_desc->add_connector_out("count", 2);
+        auto not_q0 = circuit_desc->add_not_gate();
+        auto xor_q1 = circuit_desc->add_xor_gate();
+        auto q0 = d_flipflop(not_q0->pin_id(1), clock);
+        auto q1 = d_flipflop(xor_q1->pin_id(2), clock);
+        circuit_desc->connect(q0, not_q0->pin_id(0));
+        circuit_desc->connect(q0, xor_q1->pin_id(0));
+        circuit_desc->connect(q1, xor_q1->pin_id(1));
+        circuit_desc->connect(q0, out->pin_id(0));
+        circuit_desc->connect(q1, out->pin_id(1));
+        return out;
+    };
+
+    auto read_count = [](SimCircuit *circuit, ModelComponent *out) {
+        return (circuit->read_pin(out->pin_id(0)) == VALUE_TRUE ? 1 : 0) +
+               (circuit->read_pin(out->pin_id(1)) == VALUE_TRUE ? 2 : 0);
+    };
+
+    sim->set_timing_mode(TIMING_LEVELIZED);
+
+    SECTION("input connector as clock") {
+        auto clock = circuit_desc->add_connector_in("clk", 1);
+        auto out = build_counter(clock->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        sim->add_clock(circuit->component_by_id(clock->id()));
+
+        REQUIRE(sim->run_cycles(1) == 1);
+        REQUIRE(read_count(circuit.get(), out) == 1);
+
+        for (int cycle = 2; cycle < 10; ++cycle) {
+            REQUIRE(sim->run_cycles(1) == 1);
+            REQUIRE(read_count(circuit.get(), out) == cycle % 4);
+        }
+    }
+
+    SECTION("clock that starts high") {
+        auto clock = circuit_desc->add_connector_in("clk", 1);
+        auto out = build_counter(clock->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        sim->add_clock(circuit->component_by_id(clock->id()));
+
+        REQUIRE(sim->run_until_stable(2));
+        circuit->write_pin(clock->pin_id(0), VALUE_TRUE);
+        REQUIRE(sim->run_until_stable(2));
+        REQUIRE(read_count(circuit.get(), out) == 1);
+
+        // a clock that is already high isn't a rising edge: the cycle starts with a falling edge
+        REQUIRE(sim->run_cycles(1) == 1);
+        REQUIRE(read_count(circuit.get(), out) == 2);
+        REQUIRE(sim->run_cycles(1) == 1);
+        REQUIRE(read_count(circuit.get(), out) == 3);
+
+        // going low first counts against the step budget of the rising edge: a cycle never takes more steps than
+        //  the budget of its two edges
+        circuit->write_pin(clock->pin_id(0), VALUE_TRUE);
+        REQUIRE(sim->run_until_stable(2));
+        auto start = sim->current_time();
+        sim->run_cycles(1, 7);
+        REQUIRE(sim->current_time() - start <= 2 * 7);
+    }
+
+    SECTION("multiple clocks") {
+        auto clock_a = circuit_desc->add_connector_in("clk_a", 1);
+        auto clock_b = circuit_desc->add_connector_in("clk_b", 1);
+        auto out_a = build_counter(clock_a->pin_id(0));
+        auto out_b = build_counter(clock_b->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        sim->add_clock(circuit->component_by_id(clock_a->id()));
+        sim->add_clock(circuit->component_by_id(clock_b->id()));
+
+        REQUIRE(sim->run_until_stable(2));
+        circuit->write_pin(clock_b->pin_id(0), VALUE_TRUE);
+        REQUIRE(sim->run_until_stable(2));
+        REQUIRE(read_count(circuit.get(), out_a) == 0);
+        REQUIRE(read_count(circuit.get(), out_b) == 1);
+
+        // every clock makes a transition on each edge, not only the first one
+        REQUIRE(sim->run_cycles(1) == 1);
+        REQUIRE(read_count(circuit.get(), out_a) == 1);
+        REQUIRE(read_count(circuit.get(), out_b) == 2);
+        REQUIRE(sim->run_cycles(1) == 1);
+        REQUIRE(read_count(circuit.get(), out_a) == 2);
+        REQUIRE(read_count(circuit.get(), out_b) == 3);
+    }
+
+    SECTION("oscillator as clock") {
+        auto clock = circuit_desc->add_oscillator(1000, 1000);
+        auto out = build_counter(clock->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+        sim->init();
+        sim->add_clock(circuit->component_by_id(clock->id()));
+
+        REQUIRE(sim->run_cycles(7) == 7);
+        REQUIRE(read_count(circuit.get(), out) == 7 % 4);
+
+        // the simulation time follows the clock, without simulating the idle steps in between
+        auto start = sim->current_time();
+        REQUIRE(sim->run_cycles(10) == 10);
+        REQUIRE(read_count(circuit.get(), out) == 17 % 4);
+        REQUIRE(sim->current_time() - start == 10 * 2000);
+    }
+}
+
+TEST_CASE("Bit-parallel simulation", "[simulator]") {
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    SECTION("3-bit adder: all input combinations at once") {
+        auto in_a = circuit_desc->add_connector_in("a", 3);
+        auto in_b = circuit_desc->add_connector_in("b", 3);
+        auto out = circuit_desc->add_connector_out("s", 4);
+        auto carry_in = circuit_desc->add_constant(VALUE_FALSE);
+
+        auto carry = carry_in->pin_id(0);
+        for (auto bit = 0u; bit < 3; ++bit) {
+            auto xor_ab = circuit_desc->add_xor_gate();
+            auto xor_sum = circuit_desc->add_xor_gate();
+            auto and_ab = circuit_desc->add_and_gate(2);
+            auto and_c = circuit_desc->add_and_gate(2);
+            auto or_carry = circuit_desc->add_or_gate(2);
+
+            circuit_desc->connect(in_a->pin_id(bit), xor_ab->pin_id(0));
+            circuit_desc->connect(in_b->pin_id(bit), xor_ab->pin_id(1));
+            circuit_desc->connect(xor_ab->pin_id(2), xor_sum->pin_id(0));
+            circuit_desc->connect(carry, xor_sum->pin_id(1));
+            circuit_desc->connect(xor_sum->pin_id(2), out->pin_id(bit));
+            circuit_desc->connect(in_a->pin_id(bit), and_ab->pin_id(0));
+            circuit_desc->connect(in_b->pin_id(bit), and_ab->pin_id(1));
+            circuit_desc->connect(xor_ab->pin_id(2), and_c->pin_id(0));
+            circuit_desc->connect(carry, and_c->pin_id(1));
+            circuit_desc->connect(and_ab->pin_id(2), or_carry->pin_id(0));
+            circuit_desc->connect(and_c->pin_id(2), or_carry->pin_id(1));
+            carry = or_carry->pin_id(2);
+        }
+        circuit_desc->connect(carry, out->pin_id(3));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+
+        BitParallelSimulator psim(sim);
+        REQUIRE(psim.init());
+
+        // lane = a + 8 * b
+        for (auto bit = 0u; bit < 3; ++bit) {
+            uint64_t data_a = 0;
+            uint64_t data_b = 0;
+            for (uint64_t lane = 0; lane < BIT_PARALLEL_LANES; ++lane) {
+                data_a |= ((lane >> bit) & 1) << lane;
+                data_b |= ((lane >> (bit + 3)) & 1) << lane;
+            }
+            psim.write_pin(circuit->pin_from_pin_id(in_a->pin_id(bit)), data_a);
+            psim.write_pin(circuit->pin_from_pin_id(in_b->pin_id(bit)), data_b);
+        }
+        REQUIRE(psim.run_until_stable(5));
+
+        value_container_t sum[4];
+        for (auto bit = 0u; bit < 4; ++bit) {
+            sum[bit] = psim.read_pin_values(circuit->pin_from_pin_id(out->pin_id(bit)));
+        }
+
+        for (size_t lane = 0; lane < BIT_PARALLEL_LANES; ++lane) {
+            auto expected = (lane & 7) + (lane >> 3);
+            for (auto bit = 0u; bit < 4; ++bit) {
+                REQUIRE(sum[bit][lane] == (((expected >> bit) & 1) ? VALUE_TRUE : VALUE_FALSE));
+            }
+        }
+    }
+
+    SECTION("tri-state buffers driving the same node") {
+        auto in = circuit_desc->add_connector_in("in", 2);
+        auto en = circuit_desc->add_connector_in("en", 2);
+        auto out = circuit_desc->add_connector_out("out", 1);
+        auto buf_a = circuit_desc->add_tristate_buffer(1);
+        auto buf_b = circuit_desc->add_tristate_buffer(1);
+
+        circuit_desc->connect(in->pin_id(0), buf_a->pin_id(0));
+        circuit_desc->connect(in->pin_id(1), buf_b->pin_id(0));
+        circuit_desc->connect(en->pin_id(0), buf_a->pin_id(2));
+        circuit_desc->connect(en->pin_id(1), buf_b->pin_id(2));
+        circuit_desc->connect(buf_a->pin_id(1), out->pin_id(0));
+        circuit_desc->connect(buf_b->pin_id(1), out->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+
+        BitParallelSimulator psim(sim);
+        REQUIRE(psim.init());
+
+        // lane 0: nothing enabled, lane 1: a enabled, lane 2: b enabled, lane 3: both enabled
+        psim.write_pin(circuit->pin_from_pin_id(in->pin_id(0)), value_container_t{VALUE_TRUE, VALUE_TRUE, VALUE_TRUE, VALUE_TRUE});
+        psim.write_pin(circuit->pin_from_pin_id(in->pin_id(1)), value_container_t{VALUE_FALSE, VALUE_FALSE, VALUE_FALSE, VALUE_FALSE});
+        psim.write_pin(circuit->pin_from_pin_id(en->pin_id(0)), value_container_t{VALUE_FALSE, VALUE_TRUE, VALUE_FALSE, VALUE_TRUE});
+        psim.write_pin(circuit->pin_from_pin_id(en->pin_id(1)), value_container_t{VALUE_FALSE, VALUE_FALSE, VALUE_TRUE, VALUE_TRUE});
+        REQUIRE(psim.run_until_stable(5));
+
+        auto result = psim.read_pin_values(circuit->pin_from_pin_id(out->pin_id(0)));
+        REQUIRE(result[0] == VALUE_UNDEFINED);
+        REQUIRE(result[1] == VALUE_TRUE);
+        REQUIRE(result[2] == VALUE_FALSE);
+        REQUIRE(result[3] == VALUE_ERROR);
+    }
+
+    SECTION("unsupported components") {
+        auto in = circuit_desc->add_connector_in("in", 8);
+        auto led = circuit_desc->add_7_segment_led();
+        for (auto bit = 0u; bit < 8; ++bit) {
+            circuit_desc->connect(in->pin_id(bit), led->pin_id(bit));
+        }
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+
+        BitParallelSimulator psim(sim);
+        REQUIRE_FALSE(psim.init());
+    }
+
+    SECTION("oscillating circuit") {
+        auto in = circuit_desc->add_connector_in("in", 1);
+        auto out = circuit_desc->add_connector_out("out", 1);
+        auto nand = circuit_desc->add_nand_gate(2);
+        circuit_desc->connect(in->pin_id(0), nand->pin_id(0));
+        circuit_desc->connect(nand->pin_id(2), nand->pin_id(1));
+        circuit_desc->connect(nand->pin_id(2), out->pin_id(0));
+
+        auto circuit = circuit_desc->instantiate(sim);
+        REQUIRE(circuit);
+
+        BitParallelSimulator psim(sim);
+        REQUIRE(psim.init());
+
+        // lane 0 is stable, lane 1 oscillates: the budget stops the simulation
+        psim.write_pin(circuit->pin_from_pin_id(in->pin_id(0)), value_container_t{VALUE_FALSE, VALUE_TRUE});
+        auto start = psim.current_time();
+        REQUIRE_FALSE(psim.run_until_stable(5, 100));
+        REQUIRE(psim.current_time() == start + 100);
+
+        psim.write_pin(circuit->pin_from_pin_id(in->pin_id(0)), value_container_t{VALUE_FALSE, VALUE_FALSE});
+        REQUIRE(psim.run_until_stable(5, 100));
+        REQUIRE(psim.read_pin_values(circuit->pin_from_pin_id(out->pin_id(0)))[1] == VALUE_TRUE);
+    }
+}
+
+TEST_CASE("Compiled simulation", "[simulator]") {
+
+    const size_t NUM_BITS = 4;
+
+    LSimContext lsim_context;
+    auto sim = lsim_context.sim();
+
+    auto circuit_desc = lsim_context.create_user_circuit("main");
+    REQUIRE(circuit_desc);
+
+    // a ripple carry adder, an SR latch, two tri-state buffers driving the same node and an oscillator
+    auto in = circuit_desc->add_connector_in("in", NUM_BITS * 2 + 4);
+    auto out = circuit_desc->add_connector_out("out", NUM_BITS + 4);
+
+    auto carry = circuit_desc->add_constant(VALUE_FALSE)->pin_id(0);
+    for (auto bit = 0u; bit < NUM_BITS; ++bit) {
+        auto xor_ab = circuit_desc->add_xor_gate();
+        auto xnor_sum = circuit_desc->add_xnor_gate();
+        auto not_sum = circuit_desc->add_not_gate();
+        auto nand_ab = circuit_desc->add_nand_gate(2);
+        auto nand_c = circuit_desc->add_nand_gate(2);
+        auto nand_carry = circuit_desc->add_nand_gate(2);
+
+        circuit_desc->connect(in->pin_id(bit * 2), xor_ab->pin_id(0));
+        circuit_desc->connect(in->pin_id(bit * 2 + 1), xor_ab->pin_id(1));
+        circuit_desc->connect(xor_ab->pin_id(2), xnor_sum->pin_id(0));
+        circuit_desc->connect(carry, xnor_sum->pin_id(1));
+        circuit_desc->connect(xnor_sum->pin_id(2), not_sum->pin_id(0));
+        circuit_desc->connect(not_sum->pin_id(1), out->pin_id(bit));
+        circuit_desc->connect(in->pin_id(bit * 2), nand_ab->pin_id(0));
+        circuit_desc->connect(in->pin_id(bit * 2 + 1), nand_ab->pin_id(1));
+        circuit_desc->connect(xor_ab->pin_id(2), nand_c->pin_id(0));
+        circuit_desc->connect(carry, nand_c->pin_id(1));
+        circuit_desc->connect(nand_ab->pin_id(2), nand_carry->pin_id(0));
+        circuit_desc->connect(nand_c->pin_id(2), nand_carry->pin_id(1));
+        carry = nand_carry->pin_id(2);
+    }
+    circuit_desc->connect(carry, out->pin_id(NUM_BITS));
+
+    auto nor_q = circuit_desc->add_nor_gate(2);
+    auto nor_nq = circuit_desc->add_nor_gate(2);
+    circuit_desc->connect(in->pin_id(NUM_BITS * 2), nor_q->pin_id(0));
+    circuit_desc->connect(nor_nq->pin_id(2), nor_q->pin_id(1));
+    circuit_desc->connect(in->pin_id(NUM_BITS * 2 + 1), nor_nq->pin_id(0));
+    circuit_desc->connect(nor_q->pin_id(2), nor_nq->pin_id(1));
+    circuit_desc->connect(nor_q->pin_id(2), out->pin_id(NUM_BITS + 1));
+
+    auto buf_a = circuit_desc->add_tristate_buffer(1);
+    auto buf_b = circuit_desc->add_tristate_buffer(1);
+    circuit_desc->connect(in->pin_id(NUM_BITS * 2), buf_a->pin_id(0));
+    circuit_desc->connect(in->pin_id(NUM_BITS * 2 + 1), buf_b->pin_id(0));
+    circuit_desc->connect(in->pin_id(NUM_BITS * 2 + 2), buf_a->pin_id(2));
+    circuit_desc->connect(in->pin_id(NUM_BITS * 2 + 3), buf_b->pin_id(2));
+    circuit_desc->connect(buf_a->pin_id(1), out->pin_id(NUM_BITS + 2));
+    circuit_desc->connect(buf_b->pin_id(1), out->pin_id(NUM_BITS + 2));
+
+    auto osc = circuit_desc->add_oscillator(1000, 1000);
+    circuit_desc->connect(osc->pin_id(0), out->pin_id(NUM_BITS + 3));
+
+    auto circuit = circuit_desc->instantiate(sim);
+    REQUIRE(circuit);
+
+    CompiledSimulator csim(sim);
+    auto source = csim.generate_source();
+    REQUIRE(source.find("lsim_step") != std::string::npos);
+
+#ifdef _WIN32
+    WARN("native code generation isn't supported - skipping the compiled simulation");
+#else
+    auto compiler = std::getenv("LSIM_CXX");
+    auto probe = std::string("\"") + ((compiler && *compiler) ? compiler : "c++") + "\" --version > /dev/null 2>&1";
+    if (std::system(probe.c_str()) != 0) {
+        WARN("no compiler available - skipping the compiled simulation");
+        return;
+    }
+
+    // a private cache for the test, the nested directory doesn't exist yet
+    auto tmp_dir = std::string(std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp") + "/lsim_test_XXXXXX";
+    REQUIRE(mkdtemp(&tmp_dir[0]) != nullptr);
+    auto cache_dir = tmp_dir + "/cache";
+
+    REQUIRE(csim.compile(cache_dir.c_str()));
+    REQUIRE(csim.is_compiled());
+    REQUIRE_FALSE(csim.loaded_from_cache());
+
+    // the same netlist is loaded from the cache
+    CompiledSimulator cached(sim);
+    REQUIRE(cached.compile(cache_dir.c_str()));
+    REQUIRE(cached.loaded_from_cache());
+    REQUIRE(cached.library_path() == csim.library_path());
+
+    // a cache that others can write to is refused
+    REQUIRE(chmod(cache_dir.c_str(), 0777) == 0);
+    CompiledSimulator shared(sim);
+    REQUIRE_FALSE(shared.compile(cache_dir.c_str()));
+    REQUIRE(chmod(cache_dir.c_str(), 0700) == 0);
+
+    // the paths are passed to the compiler as they are, without a shell that interprets them
+    auto odd_dir = tmp_dir + "/odd \"$HOME\" `cache`";
+    CompiledSimulator odd(sim);
+    REQUIRE(odd.compile(odd_dir.c_str()));
+    REQUIRE_FALSE(odd.loaded_from_cache());
+    auto odd_base = odd.library_path().substr(0, odd.library_path().size() - 3);
+    for (auto ext : {".so", ".cpp", ".log"}) {
+        REQUIRE(std::remove((odd_base + ext).c_str()) == 0);
+    }
+    REQUIRE(rmdir(odd_dir.c_str()) == 0);
+
+    // the compiled code follows the interpreter step by step
+    csim.init();
+
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+
+    for (int round = 0; round < 20; ++round) {
+        for (auto pin = 0u; pin < in->num_outputs(); ++pin) {
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            auto value = static_cast<Value>(random % 3);
+            circuit->write_pin(in->pin_id(pin), value);
+            csim.write_pin(circuit->pin_from_pin_id(in->pin_id(pin)), value);
+        }
+
+        for (auto step = 0u; step < 2 * NUM_BITS + 4; ++step) {
+            sim->step();
+            csim.step();
+            REQUIRE(csim.current_time() == sim->current_time());
+
+            for (auto pin = 0u; pin < out->num_inputs(); ++pin) {
+                REQUIRE(csim.read_pin(circuit->pin_from_pin_id(out->pin_id(pin))) == circuit->read_pin(out->pin_id(pin)));
+            }
+        }
+    }
+
+    // the oscillator keeps the circuit from being stable for longer than its half period
+    REQUIRE(csim.run_until_stable(2, 2000));
+    auto start = csim.current_time();
+    REQUIRE_FALSE(csim.run_until_stable(1500, 5000));
+    REQUIRE(csim.current_time() == start + 5000);
+
+    // remove the private cache
+    auto base_path = csim.library_path().substr(0, csim.library_path().size() - 3);
+    for (auto ext : {".so", ".cpp", ".log"}) {
+        std::remove((base_path + ext).c_str());
+    }
+    rmdir(cache_dir.c_str());
+    rmdir(tmp_dir.c_str());
+#endif
+}